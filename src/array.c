@@ -0,0 +1,133 @@
+#include "array.h"
+#include <stdlib.h>
+#include <string.h>
+
+array_t *
+array_new(size_t item_size)
+{
+   array_t *array;
+
+   if (!item_size)
+     return NULL;
+
+   array = calloc(1, sizeof(array_t));
+   if (!array)
+     return NULL;
+
+   array->item_size = item_size;
+
+   return array;
+}
+
+bool
+array_reserve(array_t *array, size_t count)
+{
+   size_t size;
+   void *data;
+
+   if (count <= array->size)
+     return true;
+
+   if (count > (size_t) -1 / array->item_size)
+     return false;
+
+   size = array->size ? array->size : ARRAY_SIZE_MIN;
+   while (size < count)
+     {
+        if (size > (size_t) -1 / 2)
+          {
+             size = count;
+             break;
+          }
+        size <<= 1;
+     }
+
+   if (size > (size_t) -1 / array->item_size)
+     size = count;
+
+   data = realloc(array->data, size * array->item_size);
+   if (!data)
+     return false;
+
+   array->data = data;
+   array->size = size;
+
+   return true;
+}
+
+bool
+array_append(array_t *array, const void *item)
+{
+   return array_append_n(array, item, 1);
+}
+
+bool
+array_append_n(array_t *array, const void *items, size_t count)
+{
+   if (!count)
+     return true;
+
+   if (array->count + count < array->count || !array_reserve(array, array->count + count))
+     return false;
+
+   memcpy((char *) array->data + array->count * array->item_size, items, count * array->item_size);
+   array->count += count;
+
+   return true;
+}
+
+void *
+array_push(array_t *array)
+{
+   void *item;
+
+   if (!array_reserve(array, array->count + 1))
+     return NULL;
+
+   item = (char *) array->data + array->count * array->item_size;
+   memset(item, 0, array->item_size);
+   array->count++;
+
+   return item;
+}
+
+void *
+array_get(array_t *array, size_t index)
+{
+   if (index >= array->count)
+     return NULL;
+
+   return (char *) array->data + index * array->item_size;
+}
+
+size_t
+array_count(array_t *array)
+{
+   return array->count;
+}
+
+void
+array_sort(array_t *array, int (*cmp_fn)(const void *, const void *))
+{
+   if (array->count > 1)
+     qsort(array->data, array->count, array->item_size, cmp_fn);
+}
+
+void *
+array_bsearch(array_t *array, const void *key, int (*cmp_fn)(const void *, const void *))
+{
+   if (!array->count)
+     return NULL;
+
+   return bsearch(key, array->data, array->count, array->item_size, cmp_fn);
+}
+
+void
+array_free(array_t *array)
+{
+   if (!array)
+     return;
+
+   free(array->data);
+   free(array);
+}
@@ -0,0 +1,162 @@
+#ifndef __ARRAY_H__
+#define __ARRAY_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * @file
+ * @brief These routines are for using a growable array.
+ */
+
+/* Items an array makes room for on its first append. */
+#define ARRAY_SIZE_MIN 16
+
+/**
+ * @brief Growable array creation and manipulation.
+ * @defgroup Array
+ *
+ * @{
+ *
+ * Items of a fixed size stored back to back in a single allocation.
+ *
+ * Appending copies the item into the array, which doubles its storage when
+ * full so appends take amortized constant time. Iterating touches memory in
+ * order and a whole result set is released with one call, unlike a list_t
+ * that allocates a node for every item.
+ *
+ * Pointers returned by array_get(), array_push() or array_bsearch() are only
+ * valid until the array next grows. Items are never freed by the array, an
+ * array of pointers or of structures owning memory must release them before
+ * array_free().
+ *
+ */
+typedef struct array_t
+{
+   void  *data;
+   size_t count;
+   size_t size;
+   size_t item_size;
+} array_t;
+
+/**
+ * Create a new empty array.
+ *
+ * @param item_size The size in bytes of every item.
+ *
+ * @return A pointer to the newly created array or NULL on failure.
+ */
+array_t *
+array_new(size_t item_size);
+
+/**
+ * Make sure an array can hold a number of items without growing.
+ *
+ * @param array The array to grow.
+ * @param count The total number of items it should be able to hold.
+ *
+ * @return True on success, false if memory could not be allocated.
+ */
+bool
+array_reserve(array_t *array, size_t count);
+
+/**
+ * Append a copy of an item to the end of an array.
+ *
+ * @param array The array to add to.
+ * @param item The item to copy, item_size bytes long.
+ *
+ * @return True on success, false if memory could not be allocated.
+ */
+bool
+array_append(array_t *array, const void *item);
+
+/**
+ * Append copies of several consecutive items to the end of an array.
+ *
+ * The array grows at most once.
+ *
+ * @param array The array to add to.
+ * @param items The items to copy, count * item_size bytes long.
+ * @param count The number of items.
+ *
+ * @return True on success, false if memory could not be allocated.
+ */
+bool
+array_append_n(array_t *array, const void *items, size_t count);
+
+/**
+ * Append a zeroed item to the end of an array and return it to be filled in.
+ *
+ * @param array The array to add to.
+ *
+ * @return A pointer to the new item or NULL if memory could not be allocated.
+ */
+void *
+array_push(array_t *array);
+
+/**
+ * Return the item at a position within an array.
+ *
+ * @param array The array to index.
+ * @param index The position of the item.
+ *
+ * @return A pointer to the item or NULL if index is out of range.
+ */
+void *
+array_get(array_t *array, size_t index);
+
+/**
+ * Return the number of items within an array.
+ *
+ * @param array The array to query.
+ *
+ * @return The number of items.
+ */
+size_t
+array_count(array_t *array);
+
+/**
+ * Sort the items of an array in place.
+ *
+ * The sort is not stable.
+ *
+ * @param array The array to sort.
+ * @param cmp_fn Compares two items given pointers to them, as for qsort().
+ */
+void
+array_sort(array_t *array, int (*cmp_fn)(const void *, const void *));
+
+/**
+ * Find an item within an array sorted with the same comparison.
+ *
+ * @param array The sorted array to search.
+ * @param key A pointer to an item to compare against.
+ * @param cmp_fn Compares the key with an item given pointers to them, as for bsearch().
+ *
+ * @return A pointer to a matching item or NULL if not found.
+ */
+void *
+array_bsearch(array_t *array, const void *key, int (*cmp_fn)(const void *, const void *));
+
+/**
+ * Free an array and its storage, but not anything its items point to.
+ *
+ * @param array The array to free.
+ */
+void
+array_free(array_t *array);
+
+#if defined(ARRAY_FOREACH)
+# undef ARRAY_FOREACH
+#endif
+
+#define ARRAY_FOREACH(_array, _i, _item) \
+        for (_i = 0; _i < (_array)->count && \
+             ((_item = (void *) ((char *) (_array)->data + _i * (_array)->item_size)), 1); _i++)
+
+/**
+ * @}
+ */
+
+#endif
@@ -0,0 +1,584 @@
+#include "art.h"
+#include <stdlib.h>
+#include <string.h>
+
+#if !defined(ART_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64))
+# include <emmintrin.h>
+# define ART_SSE2 1
+#endif
+
+#define ART_KEY_BYTES sizeof(size_t)
+
+enum
+{
+   ART_NODE4,
+   ART_NODE16,
+   ART_NODE48,
+   ART_NODE256,
+};
+
+/* Child pointers to leaves are tagged in their lowest bit. */
+#define LEAF_IS(p)  ((uintptr_t) (p) & 1)
+#define LEAF_GET(p) ((art_leaf_t *) ((uintptr_t) (p) & ~(uintptr_t) 1))
+#define LEAF_TAG(l) ((void *) ((uintptr_t) (l) | 1))
+
+typedef struct _art_leaf_t
+{
+   size_t  key;
+   void   *value;
+} art_leaf_t;
+
+typedef struct _art_node_t
+{
+   uint8_t  type;
+   uint8_t  prefix_len;
+   uint16_t count;
+   uint8_t  prefix[ART_KEY_BYTES];
+} art_node_t;
+
+typedef struct _art_node4_t
+{
+   art_node_t  node;
+   uint8_t     keys[4];
+   void       *children[4];
+} art_node4_t;
+
+typedef struct _art_node16_t
+{
+   art_node_t  node;
+   uint8_t     keys[16];
+   void       *children[16];
+} art_node16_t;
+
+/* index maps a key byte to its child slot plus one, zero is no child. */
+typedef struct _art_node48_t
+{
+   art_node_t  node;
+   uint8_t     index[256];
+   void       *children[48];
+} art_node48_t;
+
+typedef struct _art_node256_t
+{
+   art_node_t  node;
+   void       *children[256];
+} art_node256_t;
+
+static const size_t _node_sizes[] =
+{
+   sizeof(art_node4_t), sizeof(art_node16_t), sizeof(art_node48_t), sizeof(art_node256_t),
+};
+
+static inline unsigned int
+_key_shift(unsigned int depth)
+{
+   return 8 * (ART_KEY_BYTES - 1 - depth);
+}
+
+static inline uint8_t
+_key_byte(size_t key, unsigned int depth)
+{
+   return (key >> _key_shift(depth)) & 0xff;
+}
+
+/* The key bits below the bytes taken by depth levels. */
+static inline size_t
+_key_low_mask(unsigned int depth)
+{
+   return depth >= ART_KEY_BYTES ? 0 : SIZE_MAX >> (8 * depth);
+}
+
+static art_node_t *
+_node_new(art_t *tree, uint8_t type)
+{
+   art_node_t *node = calloc(1, _node_sizes[type]);
+   if (!node)
+     return NULL;
+
+   node->type = type;
+   tree->memory += _node_sizes[type];
+
+   return node;
+}
+
+static void
+_node_del(art_t *tree, art_node_t *node)
+{
+   tree->memory -= _node_sizes[node->type];
+   free(node);
+}
+
+static art_leaf_t *
+_leaf_new(art_t *tree, size_t key, void *value)
+{
+   art_leaf_t *leaf = malloc(sizeof(art_leaf_t));
+   if (!leaf)
+     return NULL;
+
+   leaf->key = key;
+   leaf->value = value;
+   tree->memory += sizeof(art_leaf_t);
+
+   return leaf;
+}
+
+static void **
+_child_find(art_node_t *node, uint8_t byte)
+{
+   switch (node->type)
+     {
+      case ART_NODE4:
+        {
+           art_node4_t *n = (art_node4_t *) node;
+           for (int i = 0; i < node->count; i++)
+             {
+                if (n->keys[i] == byte)
+                  return &n->children[i];
+             }
+           break;
+        }
+      case ART_NODE16:
+        {
+           art_node16_t *n = (art_node16_t *) node;
+#if defined(ART_SSE2)
+           __m128i cmp = _mm_cmpeq_epi8(_mm_set1_epi8((char) byte),
+                                        _mm_loadu_si128((const __m128i *) n->keys));
+           unsigned int mask = _mm_movemask_epi8(cmp) & ((1u << node->count) - 1);
+           if (mask)
+             return &n->children[__builtin_ctz(mask)];
+#else
+           for (int i = 0; i < node->count; i++)
+             {
+                if (n->keys[i] == byte)
+                  return &n->children[i];
+             }
+#endif
+           break;
+        }
+      case ART_NODE48:
+        {
+           art_node48_t *n = (art_node48_t *) node;
+           if (n->index[byte])
+             return &n->children[n->index[byte] - 1];
+           break;
+        }
+      case ART_NODE256:
+        {
+           art_node256_t *n = (art_node256_t *) node;
+           if (n->children[byte])
+             return &n->children[byte];
+           break;
+        }
+     }
+
+   return NULL;
+}
+
+/*
+ * Step through the children of a node in key byte order. pos starts at
+ * zero and holds the position to resume from.
+ */
+static void *
+_child_next(art_node_t *node, unsigned int *pos, uint8_t *byte)
+{
+   switch (node->type)
+     {
+      case ART_NODE4:
+      case ART_NODE16:
+        {
+           uint8_t *keys = node->type == ART_NODE4 ? ((art_node4_t *) node)->keys : ((art_node16_t *) node)->keys;
+           void **children = node->type == ART_NODE4 ? ((art_node4_t *) node)->children : ((art_node16_t *) node)->children;
+
+           if (*pos >= node->count)
+             return NULL;
+
+           *byte = keys[*pos];
+           return children[(*pos)++];
+        }
+      case ART_NODE48:
+        {
+           art_node48_t *n = (art_node48_t *) node;
+           for (; *pos < 256; (*pos)++)
+             {
+                if (n->index[*pos])
+                  {
+                     *byte = *pos;
+                     return n->children[n->index[(*pos)++] - 1];
+                  }
+             }
+           break;
+        }
+      case ART_NODE256:
+        {
+           art_node256_t *n = (art_node256_t *) node;
+           for (; *pos < 256; (*pos)++)
+             {
+                if (n->children[*pos])
+                  {
+                     *byte = *pos;
+                     return n->children[(*pos)++];
+                  }
+             }
+           break;
+        }
+     }
+
+   return NULL;
+}
+
+/* Insert into a sorted key array of a node4 or node16 with room. */
+static void
+_child_insert_sorted(uint8_t *keys, void **children, unsigned int count, uint8_t byte, void *child)
+{
+   unsigned int pos = 0;
+
+   while (pos < count && keys[pos] < byte)
+     pos++;
+
+   memmove(&keys[pos + 1], &keys[pos], count - pos);
+   memmove(&children[pos + 1], &children[pos], (count - pos) * sizeof(void *));
+
+   keys[pos] = byte;
+   children[pos] = child;
+}
+
+/*
+ * Add a child to node, which *ref points at. A full node is replaced by
+ * the next larger type first.
+ */
+static bool
+_child_add(art_t *tree, void **ref, art_node_t *node, uint8_t byte, void *child)
+{
+   art_node_t *grown;
+
+   switch (node->type)
+     {
+      case ART_NODE4:
+        {
+           art_node4_t *n = (art_node4_t *) node;
+           art_node16_t *g;
+
+           if (node->count < 4)
+             {
+                _child_insert_sorted(n->keys, n->children, node->count++, byte, child);
+                return true;
+             }
+
+           grown = _node_new(tree, ART_NODE16);
+           if (!grown)
+             return false;
+
+           g = (art_node16_t *) grown;
+           memcpy(g->keys, n->keys, sizeof(n->keys));
+           memcpy(g->children, n->children, sizeof(n->children));
+           break;
+        }
+      case ART_NODE16:
+        {
+           art_node16_t *n = (art_node16_t *) node;
+           art_node48_t *g;
+
+           if (node->count < 16)
+             {
+                _child_insert_sorted(n->keys, n->children, node->count++, byte, child);
+                return true;
+             }
+
+           grown = _node_new(tree, ART_NODE48);
+           if (!grown)
+             return false;
+
+           g = (art_node48_t *) grown;
+           for (int i = 0; i < 16; i++)
+             {
+                g->index[n->keys[i]] = i + 1;
+                g->children[i] = n->children[i];
+             }
+           break;
+        }
+      case ART_NODE48:
+        {
+           art_node48_t *n = (art_node48_t *) node;
+           art_node256_t *g;
+
+           /* Nothing is ever removed, so the used slots are contiguous. */
+           if (node->count < 48)
+             {
+                n->index[byte] = node->count + 1;
+                n->children[node->count++] = child;
+                return true;
+             }
+
+           grown = _node_new(tree, ART_NODE256);
+           if (!grown)
+             return false;
+
+           g = (art_node256_t *) grown;
+           for (int i = 0; i < 256; i++)
+             {
+                if (n->index[i])
+                  g->children[i] = n->children[n->index[i] - 1];
+             }
+           break;
+        }
+      case ART_NODE256:
+      default:
+        {
+           art_node256_t *n = (art_node256_t *) node;
+
+           n->children[byte] = child;
+           node->count++;
+           return true;
+        }
+     }
+
+   grown->count = node->count;
+   grown->prefix_len = node->prefix_len;
+   memcpy(grown->prefix, node->prefix, sizeof(node->prefix));
+
+   *ref = grown;
+   _node_del(tree, node);
+
+   return _child_add(tree, ref, grown, byte, child);
+}
+
+art_t *
+art_new(void)
+{
+   return calloc(1, sizeof(art_t));
+}
+
+bool
+art_add(art_t *tree, size_t key, void *data)
+{
+   void **ref = &tree->root, **child;
+   art_node_t *node, *parent = NULL;
+   art_leaf_t *leaf = NULL;
+   unsigned int p, depth = 0;
+
+   while (*ref)
+     {
+        if (LEAF_IS(*ref))
+          {
+             art_leaf_t *existing = LEAF_GET(*ref);
+
+             if (existing->key == key)
+               return false;
+
+             /* Replace the leaf by a node holding both, prefixed by the
+              * bytes the two keys share. */
+             parent = _node_new(tree, ART_NODE4);
+             leaf = _leaf_new(tree, key, data);
+             if (!parent || !leaf)
+               goto error;
+
+             for (p = 0; _key_byte(existing->key, depth + p) == _key_byte(key, depth + p); p++)
+               parent->prefix[p] = _key_byte(key, depth + p);
+             parent->prefix_len = p;
+
+             _child_add(tree, ref, parent, _key_byte(existing->key, depth + p), *ref);
+             _child_add(tree, ref, parent, _key_byte(key, depth + p), LEAF_TAG(leaf));
+             *ref = parent;
+             tree->count++;
+
+             return true;
+          }
+
+        node = *ref;
+
+        for (p = 0; p < node->prefix_len; p++)
+          {
+             if (node->prefix[p] != _key_byte(key, depth + p))
+               break;
+          }
+
+        if (p < node->prefix_len)
+          {
+             /* The key leaves the prefix early, split it at that byte. */
+             parent = _node_new(tree, ART_NODE4);
+             leaf = _leaf_new(tree, key, data);
+             if (!parent || !leaf)
+               goto error;
+
+             parent->prefix_len = p;
+             memcpy(parent->prefix, node->prefix, p);
+
+             _child_add(tree, ref, parent, node->prefix[p], node);
+             _child_add(tree, ref, parent, _key_byte(key, depth + p), LEAF_TAG(leaf));
+
+             node->prefix_len -= p + 1;
+             memmove(node->prefix, node->prefix + p + 1, node->prefix_len);
+
+             *ref = parent;
+             tree->count++;
+
+             return true;
+          }
+
+        depth += node->prefix_len;
+
+        child = _child_find(node, _key_byte(key, depth));
+        if (!child)
+          {
+             leaf = _leaf_new(tree, key, data);
+             if (!leaf)
+               goto error;
+
+             if (!_child_add(tree, ref, node, _key_byte(key, depth), LEAF_TAG(leaf)))
+               goto error;
+
+             tree->count++;
+
+             return true;
+          }
+
+        ref = child;
+        depth++;
+     }
+
+   leaf = _leaf_new(tree, key, data);
+   if (!leaf)
+     return false;
+
+   *ref = LEAF_TAG(leaf);
+   tree->count++;
+
+   return true;
+
+error:
+   if (parent)
+     _node_del(tree, parent);
+   if (leaf)
+     {
+        tree->memory -= sizeof(art_leaf_t);
+        free(leaf);
+     }
+
+   return false;
+}
+
+void *
+art_find(art_t *tree, size_t key)
+{
+   void *n = tree->root, **child;
+   unsigned int depth = 0;
+
+   while (n)
+     {
+        art_node_t *node;
+
+        if (LEAF_IS(n))
+          {
+             art_leaf_t *leaf = LEAF_GET(n);
+             return leaf->key == key ? leaf->value : NULL;
+          }
+
+        /* Prefixes are skipped unchecked, the leaf compares the whole key. */
+        node = n;
+        depth += node->prefix_len;
+
+        child = _child_find(node, _key_byte(key, depth));
+        if (!child)
+          return NULL;
+
+        n = *child;
+        depth++;
+     }
+
+   return NULL;
+}
+
+typedef struct _art_range_t
+{
+   size_t        lo;
+   size_t        hi;
+   art_range_cb *range_cb;
+   void         *data;
+   size_t        visited;
+} art_range_t;
+
+/* Recursion is bounded by the number of key bytes. */
+static bool
+_range(art_range_t *range, void *n, size_t path, unsigned int depth)
+{
+   art_node_t *node;
+   unsigned int pos = 0;
+   uint8_t byte;
+   void *child;
+
+   if (LEAF_IS(n))
+     {
+        art_leaf_t *leaf = LEAF_GET(n);
+
+        if (leaf->key < range->lo || leaf->key > range->hi)
+          return false;
+
+        range->visited++;
+        return range->range_cb(leaf->key, leaf->value, range->data) != 0;
+     }
+
+   node = n;
+   for (unsigned int i = 0; i < node->prefix_len; i++)
+     path |= (size_t) node->prefix[i] << _key_shift(depth + i);
+   depth += node->prefix_len;
+
+   while ((child = _child_next(node, &pos, &byte)))
+     {
+        size_t lo = path | ((size_t) byte << _key_shift(depth));
+
+        if (lo > range->hi)
+          break;
+
+        if ((lo | _key_low_mask(depth + 1)) < range->lo)
+          continue;
+
+        if (_range(range, child, lo, depth + 1))
+          return true;
+     }
+
+   return false;
+}
+
+size_t
+art_range_foreach(art_t *tree, size_t lo, size_t hi, art_range_cb range_cb, void *data)
+{
+   art_range_t range = { lo, hi, range_cb, data, 0 };
+
+   if (tree->root && lo <= hi)
+     _range(&range, tree->root, 0, 0);
+
+   return range.visited;
+}
+
+static void
+_free(void *n)
+{
+   art_node_t *node;
+   unsigned int pos = 0;
+   uint8_t byte;
+   void *child;
+
+   if (LEAF_IS(n))
+     {
+        art_leaf_t *leaf = LEAF_GET(n);
+
+        free(leaf->value);
+        free(leaf);
+        return;
+     }
+
+   node = n;
+   while ((child = _child_next(node, &pos, &byte)))
+     _free(child);
+
+   free(node);
+}
+
+void
+art_free(art_t *tree)
+{
+   if (tree->root)
+     _free(tree->root);
+
+   free(tree);
+}
@@ -0,0 +1,106 @@
+#ifndef __ART_H__
+#define __ART_H__
+
+/**
+ * @file
+ * @brief These routines are for using an adaptive radix tree.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Adaptive radix tree implementation.
+ * @defgroup ART
+ *
+ * @{
+ *
+ * An ordered map from size_t keys to data, indexed one key byte per level.
+ *
+ * Keys are split into bytes, most significant first, and each inner node
+ * picks a child by the next byte. Nodes come in four sizes holding up to
+ * 4, 16, 48 or 256 children and grow from one to the next as they fill,
+ * so sparse levels stay small while dense ones are indexed directly.
+ * Node16 is searched with a single SSE2 compare where available. Bytes
+ * shared by every key below a node are stored in it as a prefix rather
+ * than as a chain of single child nodes.
+ *
+ * Lookups cost at most one node per key byte whatever the number of
+ * keys, and clustered keys share most of their path. Define ART_NO_SIMD
+ * when building the library to force the scalar node16 search.
+ *
+ */
+
+typedef struct _art_t
+{
+   void   *root;
+   size_t  count;
+   size_t  memory;
+} art_t;
+
+typedef int (art_range_cb)(size_t key, void *value, void *data);
+
+/**
+ * Create a new adaptive radix tree.
+ *
+ * @return A pointer to the newly created tree or NULL on failure.
+ */
+art_t *
+art_new(void);
+
+/**
+ * Add an item to an adaptive radix tree.
+ *
+ * If the key is already within the tree nothing is added and the caller
+ * keeps ownership of data.
+ *
+ * @param tree The tree to add to.
+ * @param key The key used to index the data.
+ * @param data The data to be stored within the tree.
+ *
+ * @return True if the item was added, false if the key exists or on failure.
+ */
+bool
+art_add(art_t *tree, size_t key, void *data);
+
+/**
+ * Find an item within an adaptive radix tree by its key.
+ *
+ * @param tree The tree to search within.
+ * @param key The key of the data within the tree.
+ *
+ * @return A pointer to the data stored within the tree or NULL if not found.
+ */
+void *
+art_find(art_t *tree, size_t key);
+
+/**
+ * Visit the items of an adaptive radix tree with keys from lo to hi inclusive, in order.
+ *
+ * Subtrees whose keys all fall outside the range are skipped.
+ *
+ * @param tree The tree to scan.
+ * @param lo The smallest key to visit.
+ * @param hi The largest key to visit.
+ * @param range_cb The callback triggered for each item, returning non-zero stops the scan.
+ * @param data User data to pass to the callback.
+ *
+ * @return The number of items visited.
+ */
+size_t
+art_range_foreach(art_t *tree, size_t lo, size_t hi, art_range_cb range_cb, void *data);
+
+/**
+ * Free the whole adaptive radix tree including all data.
+ *
+ * @param tree The tree to free.
+ */
+void
+art_free(art_t *tree);
+
+/**
+ * @}
+ */
+
+#endif
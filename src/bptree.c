@@ -0,0 +1,291 @@
+#include "bptree.h"
+#include <stdlib.h>
+#include <string.h>
+
+static bptree_node_t *
+_node_new(bool leaf)
+{
+   bptree_node_t *node;
+
+   if (posix_memalign((void **) &node, 64, sizeof(bptree_node_t)))
+     return NULL;
+
+   memset(node, 0, sizeof(bptree_node_t));
+
+   /* Unused keys sort last so searches can always scan the full width. */
+   for (int i = 0; i < BPTREE_KEYS; i++)
+     node->keys[i] = SIZE_MAX;
+
+   node->leaf = leaf;
+
+   return node;
+}
+
+/* Number of keys less than key. */
+static inline unsigned int
+_node_lower(const bptree_node_t *node, size_t key)
+{
+   unsigned int n = 0;
+
+   for (int i = 0; i < BPTREE_KEYS; i++)
+     n += node->keys[i] < key;
+
+   return n;
+}
+
+/* Number of keys less than or equal to key, the child holding key. */
+static inline unsigned int
+_node_upper(const bptree_node_t *node, size_t key)
+{
+   unsigned int n = 0;
+
+   for (int i = 0; i < BPTREE_KEYS; i++)
+     n += node->keys[i] <= key;
+
+   return n < node->count ? n : node->count;
+}
+
+static bptree_node_t *
+_leaf_find(const bptree_t *tree, size_t key)
+{
+   bptree_node_t *node = tree->root;
+
+   while (!node->leaf)
+     node = node->children[_node_upper(node, key)];
+
+   return node;
+}
+
+bptree_t *
+bptree_new(void)
+{
+   bptree_t *tree = calloc(1, sizeof(bptree_t));
+   if (!tree)
+     return NULL;
+
+   tree->root = _node_new(true);
+   if (!tree->root)
+     {
+        free(tree);
+        return NULL;
+     }
+
+   tree->height = 1;
+
+   return tree;
+}
+
+static void
+_leaf_insert(bptree_node_t *leaf, unsigned int pos, size_t key, void *data)
+{
+   memmove(&leaf->keys[pos + 1], &leaf->keys[pos], (leaf->count - pos) * sizeof(size_t));
+   memmove(&leaf->values[pos + 1], &leaf->values[pos], (leaf->count - pos) * sizeof(void *));
+
+   leaf->keys[pos] = key;
+   leaf->values[pos] = data;
+   leaf->count++;
+}
+
+static void
+_internal_insert(bptree_node_t *node, unsigned int pos, size_t key, bptree_node_t *child)
+{
+   memmove(&node->keys[pos + 1], &node->keys[pos], (node->count - pos) * sizeof(size_t));
+   memmove(&node->children[pos + 2], &node->children[pos + 1], (node->count - pos) * sizeof(bptree_node_t *));
+
+   node->keys[pos] = key;
+   node->children[pos + 1] = child;
+   node->count++;
+}
+
+/* Split a full internal node into right while inserting key and child at
+ * pos. The middle key moves up and is returned in key, right in child. */
+static void
+_internal_split(bptree_node_t *node, bptree_node_t *right, unsigned int pos,
+                size_t *key, bptree_node_t **child)
+{
+   size_t keys[BPTREE_KEYS + 1];
+   bptree_node_t *children[BPTREE_KEYS + 2];
+   unsigned int i, mid = (BPTREE_KEYS + 1) / 2;
+
+   memcpy(keys, node->keys, pos * sizeof(size_t));
+   keys[pos] = *key;
+   memcpy(&keys[pos + 1], &node->keys[pos], (BPTREE_KEYS - pos) * sizeof(size_t));
+
+   memcpy(children, node->children, (pos + 1) * sizeof(bptree_node_t *));
+   children[pos + 1] = *child;
+   memcpy(&children[pos + 2], &node->children[pos + 1], (BPTREE_KEYS - pos) * sizeof(bptree_node_t *));
+
+   for (i = 0; i < BPTREE_KEYS; i++)
+     node->keys[i] = i < mid ? keys[i] : SIZE_MAX;
+   memcpy(node->children, children, (mid + 1) * sizeof(bptree_node_t *));
+   node->count = mid;
+
+   right->count = BPTREE_KEYS - mid;
+   memcpy(right->keys, &keys[mid + 1], right->count * sizeof(size_t));
+   memcpy(right->children, &children[mid + 1], (right->count + 1) * sizeof(bptree_node_t *));
+
+   *key = keys[mid];
+   *child = right;
+}
+
+bool
+bptree_add(bptree_t *tree, size_t key, void *data)
+{
+   bptree_node_t *path[BPTREE_DEPTH_MAX];
+   bptree_node_t *spare[BPTREE_DEPTH_MAX + 1];
+   unsigned int slots[BPTREE_DEPTH_MAX];
+   bptree_node_t *node = tree->root, *right;
+   unsigned int i, pos, needed, depth = 0, split = BPTREE_KEYS / 2;
+
+   while (!node->leaf)
+     {
+        pos = _node_upper(node, key);
+        path[depth] = node;
+        slots[depth++] = pos;
+        node = node->children[pos];
+     }
+
+   pos = _node_lower(node, key);
+   if (pos < node->count && node->keys[pos] == key)
+     return false;
+
+   if (node->count < BPTREE_KEYS)
+     {
+        _leaf_insert(node, pos, key, data);
+        tree->count++;
+        return true;
+     }
+
+   /*
+    * The split carries up through every full parent, possibly adding a new
+    * root. Allocate all the nodes needed first so failing leaves the tree
+    * untouched.
+    */
+   for (needed = 1; needed <= depth && path[depth - needed]->count == BPTREE_KEYS; needed++);
+   if (needed > depth)
+     needed++;
+
+   for (i = 0; i < needed; i++)
+     {
+        spare[i] = _node_new(i == 0);
+        if (!spare[i])
+          {
+             while (i--)
+               free(spare[i]);
+             return false;
+          }
+     }
+
+   /* Appending to the last leaf, as with increasing keys, leaves it full. */
+   if (pos == BPTREE_KEYS && !node->next)
+     split = BPTREE_KEYS;
+
+   right = spare[0];
+   right->count = BPTREE_KEYS - split;
+   memcpy(right->keys, &node->keys[split], right->count * sizeof(size_t));
+   memcpy(right->values, &node->values[split], right->count * sizeof(void *));
+   for (i = split; i < BPTREE_KEYS; i++)
+     node->keys[i] = SIZE_MAX;
+   node->count = split;
+
+   right->next = node->next;
+   node->next = right;
+
+   if (pos < split)
+     _leaf_insert(node, pos, key, data);
+   else
+     _leaf_insert(right, pos - split, key, data);
+
+   tree->count++;
+
+   /* Push the first key of the new node up until a parent has room. */
+   key = right->keys[0];
+
+   for (i = 1; depth > 0; i++)
+     {
+        node = path[--depth];
+        pos = slots[depth];
+
+        if (node->count < BPTREE_KEYS)
+          {
+             _internal_insert(node, pos, key, right);
+             return true;
+          }
+
+        _internal_split(node, spare[i], pos, &key, &right);
+     }
+
+   node = spare[i];
+   node->keys[0] = key;
+   node->children[0] = tree->root;
+   node->children[1] = right;
+   node->count = 1;
+
+   tree->root = node;
+   tree->height++;
+
+   return true;
+}
+
+void *
+bptree_find(bptree_t *tree, size_t key)
+{
+   bptree_node_t *leaf = _leaf_find(tree, key);
+   unsigned int pos = _node_lower(leaf, key);
+
+   if (pos < leaf->count && leaf->keys[pos] == key)
+     return leaf->values[pos];
+
+   return NULL;
+}
+
+size_t
+bptree_scan(bptree_t *tree, size_t lo, size_t hi, bptree_scan_cb scan_cb, void *data)
+{
+   bptree_node_t *leaf;
+   unsigned int pos;
+   size_t visited = 0;
+
+   if (lo > hi)
+     return 0;
+
+   leaf = _leaf_find(tree, lo);
+   pos = _node_lower(leaf, lo);
+
+   for (; leaf; leaf = leaf->next, pos = 0)
+     {
+        for (; pos < leaf->count; pos++)
+          {
+             if (leaf->keys[pos] > hi)
+               return visited;
+
+             visited++;
+             if (scan_cb(leaf->keys[pos], leaf->values[pos], data))
+               return visited;
+          }
+     }
+
+   return visited;
+}
+
+/* Recursion is bounded by the height of the tree. */
+static void
+_node_free(bptree_node_t *node)
+{
+   for (unsigned int i = 0; i < node->count + !node->leaf; i++)
+     {
+        if (node->leaf)
+          free(node->values[i]);
+        else
+          _node_free(node->children[i]);
+     }
+
+   free(node);
+}
+
+void
+bptree_free(bptree_t *tree)
+{
+   _node_free(tree->root);
+   free(tree);
+}
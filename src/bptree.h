@@ -0,0 +1,119 @@
+#ifndef __BPTREE_H__
+#define __BPTREE_H__
+
+/**
+ * @file
+ * @brief These routines are for using a B+tree.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Keys held by a node, a node is a few cache lines wide. */
+#define BPTREE_KEYS 32
+
+/* Deepest tree supported, far beyond what fits in memory. */
+#define BPTREE_DEPTH_MAX 16
+
+/**
+ * @brief B+tree implementation.
+ * @defgroup BPTree
+ *
+ * @{
+ *
+ * An ordered map from size_t keys to data with wide nodes.
+ *
+ * Each node holds up to BPTREE_KEYS sorted keys, so a lookup touches a
+ * handful of nodes rather than one per level of a binary tree. Searching
+ * within a node counts the keys below the one wanted over the whole fixed
+ * width of the node, which has no branches to mispredict and which the
+ * compiler can vectorize. Data lives only in the leaves and the leaves
+ * are linked in key order, so scanning a range walks them directly.
+ *
+ */
+
+typedef struct _bptree_node_t bptree_node_t;
+struct _bptree_node_t
+{
+   size_t         keys[BPTREE_KEYS];
+   unsigned int   count;
+   bool           leaf;
+   bptree_node_t *next;
+   union
+   {
+      bptree_node_t *children[BPTREE_KEYS + 1];
+      void          *values[BPTREE_KEYS];
+   };
+};
+
+typedef struct _bptree_t
+{
+   bptree_node_t *root;
+   size_t         count;
+   unsigned int   height;
+} bptree_t;
+
+typedef int (bptree_scan_cb)(size_t key, void *value, void *data);
+
+/**
+ * Create a new B+tree.
+ *
+ * @return A pointer to the newly created tree or NULL on failure.
+ */
+bptree_t *
+bptree_new(void);
+
+/**
+ * Add an item to a B+tree.
+ *
+ * If the key is already within the tree nothing is added and the caller
+ * keeps ownership of data.
+ *
+ * @param tree The tree to add to.
+ * @param key The key used to index the data.
+ * @param data The data to be stored within the tree.
+ *
+ * @return True if the item was added, false if the key exists or on failure.
+ */
+bool
+bptree_add(bptree_t *tree, size_t key, void *data);
+
+/**
+ * Find an item within a B+tree by its key.
+ *
+ * @param tree The tree to search within.
+ * @param key The key of the data within the tree.
+ *
+ * @return A pointer to the data stored within the tree or NULL if not found.
+ */
+void *
+bptree_find(bptree_t *tree, size_t key);
+
+/**
+ * Visit the items of a B+tree with keys from lo to hi inclusive, in order.
+ *
+ * @param tree The tree to scan.
+ * @param lo The smallest key to visit.
+ * @param hi The largest key to visit.
+ * @param scan_cb The callback triggered for each item, returning non-zero stops the scan.
+ * @param data User data to pass to the callback.
+ *
+ * @return The number of items visited.
+ */
+size_t
+bptree_scan(bptree_t *tree, size_t lo, size_t hi, bptree_scan_cb scan_cb, void *data);
+
+/**
+ * Free the whole B+tree including all data.
+ *
+ * @param tree The tree to free.
+ */
+void
+bptree_free(bptree_t *tree);
+
+/**
+ * @}
+ */
+
+#endif
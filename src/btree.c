@@ -2,6 +2,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <stdbool.h>
 
 tree_t *
 tree_new(void)
@@ -10,61 +11,497 @@ tree_new(void)
 }
 
 static tree_t *
-_leaf_new(size_t value, void *data)
+_leaf_new(size_t value, void *data, tree_t *parent, pool_t *pool)
 {
-   tree_t *leaf = malloc(sizeof(tree_t));
+   tree_t *leaf = pool ? pool_alloc(pool) : malloc(sizeof(tree_t));
+   if (!leaf)
+     return NULL;
+
    leaf->value = value;
    leaf->data = data;
    leaf->left = leaf->right = NULL;
+   leaf->parent = parent;
+   leaf->height = 1;
 
    return leaf;
 }
 
+static inline int
+_height(const tree_t *node)
+{
+   return node ? node->height : 0;
+}
+
+static inline int
+_balance(const tree_t *node)
+{
+   return _height(node->left) - _height(node->right);
+}
+
+static inline void
+_height_update(tree_t *node)
+{
+   int left = _height(node->left), right = _height(node->right);
+
+   node->height = (left > right ? left : right) + 1;
+}
+
+/* Both rotations return the new top of the subtree, linked to the old
+ * top's parent. The caller relinks the parent's child pointer. */
+static tree_t *
+_rotate_left(tree_t *node)
+{
+   tree_t *top = node->right;
+
+   node->right = top->left;
+   if (top->left)
+     top->left->parent = node;
+
+   top->parent = node->parent;
+   top->left = node;
+   node->parent = top;
+
+   _height_update(node);
+   _height_update(top);
+
+   return top;
+}
+
+static tree_t *
+_rotate_right(tree_t *node)
+{
+   tree_t *top = node->left;
+
+   node->left = top->right;
+   if (top->right)
+     top->right->parent = node;
+
+   top->parent = node->parent;
+   top->right = node;
+   node->parent = top;
+
+   _height_update(node);
+   _height_update(top);
+
+   return top;
+}
+
+/* Walk up from node restoring heights and balance, returns the root. */
+static tree_t *
+_tree_rebalance(tree_t *root, tree_t *node)
+{
+   while (node)
+     {
+        tree_t *parent = node->parent, *top;
+        int height = node->height, balance;
+
+        _height_update(node);
+        balance = _balance(node);
+
+        if (balance > 1)
+          {
+             if (_balance(node->left) < 0)
+               node->left = _rotate_left(node->left);
+             top = _rotate_right(node);
+          }
+        else if (balance < -1)
+          {
+             if (_balance(node->right) > 0)
+               node->right = _rotate_right(node->right);
+             top = _rotate_left(node);
+          }
+        else
+          {
+             /* Nothing above can change. */
+             if (node->height == height)
+               break;
+             top = node;
+          }
+
+        if (!parent)
+          root = top;
+        else if (parent->left == node)
+          parent->left = top;
+        else
+          parent->right = top;
+
+        node = parent;
+     }
+
+   return root;
+}
+
+static void
+_tree_free(tree_t *root, bool data, pool_t *pool);
+
+/* Height of a tree of count nodes built by splitting at the midpoint. */
+static inline int
+_height_for(size_t count)
+{
+   return (int) (sizeof(size_t) * 8) - __builtin_clzl(count);
+}
+
+typedef struct _tree_range_t
+{
+   size_t   lo;
+   size_t   hi;
+   tree_t  *parent;
+   tree_t **link;
+} tree_range_t;
+
 tree_t *
-tree_add(tree_t *leaf, size_t value, void *data)
+tree_build_sorted(const size_t *values, void **items, size_t count)
+{
+   tree_range_t stack[sizeof(size_t) * 16];
+   tree_t *root = NULL;
+   unsigned int depth = 0;
+
+   if (!count) return NULL;
+
+   stack[depth++] = (tree_range_t) { 0, count, NULL, &root };
+
+   /* Depth first, each range pushes at most two halves of itself. */
+   while (depth)
+     {
+        tree_range_t range = stack[--depth];
+        size_t mid;
+        tree_t *node;
+
+        if (range.lo >= range.hi)
+          continue;
+
+        mid = range.lo + (range.hi - range.lo) / 2;
+
+        node = _leaf_new(values[mid], items[mid], range.parent, NULL);
+        if (!node)
+          {
+             _tree_free(root, false, NULL);
+             return NULL;
+          }
+
+        node->height = _height_for(range.hi - range.lo);
+        *range.link = node;
+
+        stack[depth++] = (tree_range_t) { mid + 1, range.hi, node, &node->right };
+        stack[depth++] = (tree_range_t) { range.lo, mid, node, &node->left };
+     }
+
+   return root;
+}
+
+static tree_t *
+_tree_add(tree_t *root, size_t value, void *data, pool_t *pool)
 {
+   tree_t *leaf, *node = root, *parent = NULL;
+
+   while (node)
+     {
+        parent = node;
+
+        if (value < node->value)
+          node = node->left;
+        else if (value > node->value)
+          node = node->right;
+        else
+          return root;
+     }
+
+   leaf = _leaf_new(value, data, parent, pool);
    if (!leaf)
+     return root;
+
+   if (!parent)
+     return leaf;
+
+   if (value < parent->value)
+     parent->left = leaf;
+   else
+     parent->right = leaf;
+
+   return _tree_rebalance(root, parent);
+}
+
+tree_t *
+tree_add(tree_t *root, size_t value, void *data)
+{
+   return _tree_add(root, value, data, NULL);
+}
+
+tree_t *
+tree_add_pool(tree_t *root, pool_t *pool, size_t value, void *data)
+{
+   return _tree_add(root, value, data, pool);
+}
+
+void *
+tree_find(tree_t *node, size_t value)
+{
+   while (node)
+     {
+        if (value < node->value)
+          node = node->left;
+        else if (value > node->value)
+          node = node->right;
+        else
+          return node->data;
+     }
+
+   return NULL;
+}
+
+tree_t *
+tree_lower_bound(tree_t *node, size_t value)
+{
+   tree_t *found = NULL;
+
+   while (node)
      {
-        leaf = _leaf_new(value, data);
-        return leaf;
+        if (node->value < value)
+          node = node->right;
+        else
+          {
+             found = node;
+             node = node->left;
+          }
      }
 
-   if (leaf->value < value)
+   return found;
+}
+
+tree_t *
+tree_upper_bound(tree_t *node, size_t value)
+{
+   tree_t *found = NULL;
+
+   while (node)
      {
-        leaf->left = tree_add(leaf->left, value, data);
+        if (node->value <= value)
+          node = node->right;
+        else
+          {
+             found = node;
+             node = node->left;
+          }
      }
-   else if (leaf->value > value)
+
+   return found;
+}
+
+tree_t *
+tree_first(tree_t *node)
+{
+   if (!node) return NULL;
+
+   while (node->left)
+     node = node->left;
+
+   return node;
+}
+
+tree_t *
+tree_last(tree_t *node)
+{
+   if (!node) return NULL;
+
+   while (node->right)
+     node = node->right;
+
+   return node;
+}
+
+tree_t *
+tree_next(tree_t *node)
+{
+   if (!node) return NULL;
+
+   if (node->right)
+     return tree_first(node->right);
+
+   while (node->parent && node->parent->right == node)
+     node = node->parent;
+
+   return node->parent;
+}
+
+tree_t *
+tree_prev(tree_t *node)
+{
+   if (!node) return NULL;
+
+   if (node->left)
+     return tree_last(node->left);
+
+   while (node->parent && node->parent->left == node)
+     node = node->parent;
+
+   return node->parent;
+}
+
+size_t
+tree_range_foreach(tree_t *node, size_t lo, size_t hi, tree_range_cb range_cb, void *data)
+{
+   size_t visited = 0;
+
+   for (node = tree_lower_bound(node, lo); node && node->value <= hi; node = tree_next(node))
      {
-        leaf->right = tree_add(leaf->right, value, data);
+        visited++;
+        if (range_cb(node->value, node->data, data))
+          break;
      }
 
-   return leaf;
+   return visited;
 }
 
-void *
-tree_find(tree_t *leaf, size_t value)
+static void
+_node_free(tree_t *node, pool_t *pool)
 {
-   if (!leaf) return NULL;
+   if (pool)
+     pool_release(pool, node);
+   else
+     free(node);
+}
 
-   if (leaf->value < value)
-     return tree_find(leaf->left, value);
-   else if (leaf->value > value)
-     return tree_find(leaf->right, value);
+static void
+_tree_free(tree_t *root, bool data, pool_t *pool)
+{
+   tree_t *parent, *node = root;
 
-   return leaf->data;
+   if (!root) return;
+
+   /* Post-order walk, each node is unlinked from its parent as it goes. */
+   while (1)
+     {
+        if (node->left)
+          {
+             node = node->left;
+             continue;
+          }
+
+        if (node->right)
+          {
+             node = node->right;
+             continue;
+          }
+
+        if (node == root)
+          break;
+
+        parent = node->parent;
+        if (parent->left == node)
+          parent->left = NULL;
+        else
+          parent->right = NULL;
+
+        if (data)
+          free(node->data);
+        _node_free(node, pool);
+
+        node = parent;
+     }
+
+   if (data)
+     free(root->data);
+   _node_free(root, pool);
+}
+
+void
+tree_free(tree_t *root)
+{
+   _tree_free(root, true, NULL);
 }
 
 void
-tree_free(tree_t *leaf)
+tree_free_pool(tree_t *root, pool_t *pool)
 {
-   if (!leaf) return;
+   _tree_free(root, true, pool);
+}
+
+tree_frozen_t *
+tree_freeze(tree_t *root)
+{
+   tree_frozen_t *frozen;
+   tree_t *node;
+   size_t k, count = 0;
+
+   for (node = tree_first(root); node; node = tree_next(node))
+     count++;
+
+   frozen = calloc(1, sizeof(tree_frozen_t));
+   if (!frozen)
+     return NULL;
+
+   /* Slot 0 is unused so the children of slot k are 2k and 2k + 1. */
+   if (posix_memalign((void **) &frozen->values, 64, (count + 1) * sizeof(size_t)))
+     {
+        free(frozen);
+        return NULL;
+     }
+
+   frozen->items = malloc((count + 1) * sizeof(void *));
+   if (!frozen->items)
+     {
+        free(frozen->values);
+        free(frozen);
+        return NULL;
+     }
 
-   if (leaf->left)
-     tree_free(leaf->left);
-   if (leaf->right)
-     tree_free(leaf->right);
+   frozen->count = count;
 
-   free(leaf->data);
-   free(leaf);
+   /* Walk the tree in order while walking the implicit tree in order. */
+   for (k = 1; k * 2 <= count; k *= 2);
+
+   for (node = tree_first(root); node; node = tree_next(node))
+     {
+        frozen->values[k] = node->value;
+        frozen->items[k] = node->data;
+
+        if (k * 2 + 1 <= count)
+          {
+             for (k = k * 2 + 1; k * 2 <= count; k *= 2);
+          }
+        else
+          {
+             while (k & 1)
+               k >>= 1;
+             k >>= 1;
+          }
+     }
+
+   _tree_free(root, false, NULL);
+
+   return frozen;
 }
 
+void *
+tree_frozen_find(tree_frozen_t *frozen, size_t value)
+{
+   const size_t *values = frozen->values;
+   size_t k = 1;
+
+   while (k <= frozen->count)
+     {
+        /* Four levels down are sixteen consecutive slots, one cache line away. */
+        __builtin_prefetch(&values[k * 16]);
+        k = 2 * k + (values[k] < value);
+     }
+
+   /* Undo the right turns taken after the last left turn, which was the
+    * first value not less than the one searched for. */
+   k >>= __builtin_ffsl((long) ~k);
+
+   if (k && values[k] == value)
+     return frozen->items[k];
+
+   return NULL;
+}
+
+void
+tree_frozen_free(tree_frozen_t *frozen)
+{
+   for (size_t k = 1; k <= frozen->count; k++)
+     free(frozen->items[k]);
+
+   free(frozen->values);
+   free(frozen->items);
+   free(frozen);
+}
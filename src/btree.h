@@ -3,9 +3,10 @@
 
 /**
  * @file
- * @brief These routines are for using a simple binary tree.
+ * @brief These routines are for using a balanced binary tree.
  */
 
+#include "pool.h"
 #include <unistd.h>
 
 /**
@@ -14,7 +15,20 @@
  *
  * @{
  *
- * Manipulation of simple binary tree.
+ * Manipulation of a binary tree ordered by value.
+ *
+ * The tree is kept AVL balanced, so its height stays logarithmic whatever
+ * order values are added in, including the common case of increasing ids.
+ * Nodes link to their parent and all operations are iterative, no call
+ * recurses down the tree.
+ *
+ * A tree that is only read can be frozen into a tree_frozen_t, a pair of
+ * arrays holding the values in breadth first (Eytzinger) order. Searching
+ * it follows array indices instead of pointers, without branches, and
+ * prefetches the levels ahead of it.
+ *
+ * Nodes can be taken from a pool_t with tree_add_pool(), a tree built that
+ * way must be freed with tree_free_pool() and can't be frozen.
  *
  */
 
@@ -23,10 +37,19 @@ struct tree_t
 {
    tree_t *left;
    tree_t *right;
+   tree_t *parent;
+   int height;
    size_t value;
    void *data;
 };
 
+typedef struct tree_frozen_t
+{
+   size_t *values;
+   void  **items;
+   size_t  count;
+} tree_frozen_t;
+
 /**
  * Create a new tree.
  *
@@ -35,18 +58,46 @@ struct tree_t
 tree_t *
 tree_new(void);
 
+/**
+ * Create a balanced tree from sorted arrays in O(n).
+ *
+ * @param values The values to index the items by, in strictly ascending order.
+ * @param items The items to store within the tree, owned by the tree on success.
+ * @param count The number of values and items.
+ *
+ * @return A pointer to the tree or NULL if empty or on failure.
+ */
+tree_t *
+tree_build_sorted(const size_t *values, void **items, size_t count);
+
 /**
  * Add an item to the tree.
  *
+ * If the value is already within the tree nothing is added and the caller
+ * keeps ownership of data.
+ *
  * @param node A pointer to the tree.
  * @param value The value used to index the data.
  * @param data The data to be stored within the tree.
  *
- * @return A pointer to the tree with the newly inserted item.
+ * @return A pointer to the tree with the newly inserted item, its root may have changed.
  */
 tree_t *
 tree_add(tree_t *node, size_t value, void *data);
 
+/**
+ * Add an item to the tree, allocating its node from a pool.
+ *
+ * @param node A pointer to the tree.
+ * @param pool A pool of objects at least sizeof(tree_t) bytes, the same for every node of the tree.
+ * @param value The value used to index the data.
+ * @param data The data to be stored within the tree.
+ *
+ * @return A pointer to the tree with the newly inserted item, its root may have changed.
+ */
+tree_t *
+tree_add_pool(tree_t *node, pool_t *pool, size_t value, void *data);
+
 /**
  * Find item within a tree by its value.
  *
@@ -58,6 +109,89 @@ tree_add(tree_t *node, size_t value, void *data);
 void *
 tree_find(tree_t *node, size_t value);
 
+/**
+ * Find the first node of a tree whose value is not less than value.
+ *
+ * @param node The tree to search within.
+ * @param value The value to search for.
+ *
+ * @return The node found or NULL if every value is less.
+ */
+tree_t *
+tree_lower_bound(tree_t *node, size_t value);
+
+/**
+ * Find the first node of a tree whose value is greater than value.
+ *
+ * @param node The tree to search within.
+ * @param value The value to search for.
+ *
+ * @return The node found or NULL if no value is greater.
+ */
+tree_t *
+tree_upper_bound(tree_t *node, size_t value);
+
+/**
+ * Return the node of a tree with the smallest value.
+ *
+ * @param node The tree.
+ *
+ * @return The first node or NULL if the tree is empty.
+ */
+tree_t *
+tree_first(tree_t *node);
+
+/**
+ * Return the node of a tree with the largest value.
+ *
+ * @param node The tree.
+ *
+ * @return The last node or NULL if the tree is empty.
+ */
+tree_t *
+tree_last(tree_t *node);
+
+/**
+ * Move a cursor to the node with the next larger value.
+ *
+ * Stepping through a whole tree costs amortized O(1) per node and
+ * allocates nothing. The tree must not be added to while stepping.
+ *
+ * @param node The current node.
+ *
+ * @return The next node or NULL at the end of the tree.
+ */
+tree_t *
+tree_next(tree_t *node);
+
+/**
+ * Move a cursor to the node with the next smaller value.
+ *
+ * @param node The current node.
+ *
+ * @return The previous node or NULL at the start of the tree.
+ */
+tree_t *
+tree_prev(tree_t *node);
+
+typedef int (tree_range_cb)(size_t value, void *item, void *data);
+
+/**
+ * Visit the items of a tree with values from lo to hi inclusive, in order.
+ *
+ * Only the nodes in range and the path down to the first are visited.
+ *
+ * @param node The tree to scan.
+ * @param lo The smallest value to visit.
+ * @param hi The largest value to visit.
+ * @param range_cb The callback triggered for each item, returning non-zero stops the scan.
+ * @param data User data to pass to the callback.
+ *
+ * @return The number of items visited.
+ */
+size_t
+tree_range_foreach(tree_t *node, size_t lo, size_t hi, tree_range_cb range_cb, void *data);
+
 /**
  * Free the whole tree including all data.
  *
@@ -67,6 +201,47 @@ tree_find(tree_t *node, size_t value);
 void
 tree_free(tree_t *node);
 
+/**
+ * Free a tree built with tree_add_pool() including all data.
+ *
+ * @param node The tree to free.
+ * @param pool The pool its nodes came from.
+ */
+void
+tree_free_pool(tree_t *node, pool_t *pool);
+
+/**
+ * Convert a tree into a read-only frozen tree.
+ *
+ * The tree's nodes are freed and its data moves to the frozen tree. On
+ * failure the tree is left untouched.
+ *
+ * @param node The tree to freeze.
+ *
+ * @return A pointer to the frozen tree or NULL on failure.
+ */
+tree_frozen_t *
+tree_freeze(tree_t *node);
+
+/**
+ * Find item within a frozen tree by its value.
+ *
+ * @param frozen The frozen tree to search within.
+ * @param value The index of the data within the tree.
+ *
+ * @return A pointer to the data stored within the tree or NULL if not found.
+ */
+void *
+tree_frozen_find(tree_frozen_t *frozen, size_t value);
+
+/**
+ * Free a frozen tree including all data.
+ *
+ * @param frozen The frozen tree to free.
+ */
+void
+tree_frozen_free(tree_frozen_t *frozen);
+
 /**
  * @}
  */
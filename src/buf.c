@@ -3,27 +3,99 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdarg.h>
+#include <limits.h>
 #include <unistd.h>
+#include <errno.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
 
 buf_t *
 buf_new(void)
 {
-   buf_t *buf = calloc(1, sizeof(buf_t));
+   buf_t *buf = malloc(sizeof(buf_t));
+   if (!buf)
+     return NULL;
+
+   buf_init(buf);
 
    return buf;
 }
 
+void
+buf_init(buf_t *buf)
+{
+   buf->len = 0;
+   buf->size = BUF_INLINE_SIZE;
+   buf->data = buf->inline_data;
+   buf->data[0] = '\0';
+}
+
+void
+buf_clear(buf_t *buf)
+{
+   if (buf->data != buf->inline_data)
+     free(buf->data);
+
+   buf_init(buf);
+}
+
+bool
+buf_reserve(buf_t *buf, ssize_t size)
+{
+   ssize_t capacity;
+   char *data;
+
+   if (size < 0)
+     return false;
+
+   /* Leave room for the terminating NULL character. */
+   if (size < buf->size)
+     return true;
+
+   capacity = buf->size ? buf->size : BUF_INLINE_SIZE;
+   while (capacity <= size)
+     {
+        if (capacity > SSIZE_MAX / 2)
+          {
+             capacity = size + 1;
+             break;
+          }
+        capacity <<= 1;
+     }
+
+   /* Contents spilling out of the inline area are copied, not reallocated. */
+   if (buf->data == buf->inline_data)
+     {
+        data = malloc(capacity);
+        if (data)
+          memcpy(data, buf->inline_data, buf->len);
+     }
+   else
+     {
+        data = realloc(buf->data, capacity);
+     }
+
+   if (!data)
+     return false;
+
+   buf->data = data;
+   buf->size = capacity;
+
+   return true;
+}
+
 void
 buf_grow(buf_t *buf, ssize_t len)
 {
-   void *tmp = realloc(buf->data, buf->len + len + 1);
-   buf->data = tmp;
+   buf_reserve(buf, buf->len + len);
 }
 
 void
 buf_append_data(buf_t *buf, const char *data, ssize_t len)
 {
-   buf_grow(buf, len);
+   if (!buf_reserve(buf, buf->len + len))
+     return;
+
    memcpy(buf->data + buf->len, data, len);
    buf->len += len;
 }
@@ -40,39 +112,92 @@ buf_append(buf_t *buf, const char *string)
 void
 buf_append_printf(buf_t *buf, const char *fmt, ...)
 {
-   char tmp_buf[4096];
    va_list ap, ap2;
    int len;
 
    va_start(ap, fmt);
    va_copy(ap2, ap);
 
-   len = vsnprintf(tmp_buf, sizeof(tmp_buf), fmt, ap);
-   if (len < (int)sizeof(tmp_buf))
-     {
-        buf_append(buf, tmp_buf);
-     }
-   else
+   /* Format straight into the free space, retrying once it has grown. */
+   len = vsnprintf(buf->data + buf->len, buf->size - buf->len, fmt, ap);
+   if (len < 0)
+     goto done;
+
+   if (len >= buf->size - buf->len)
      {
-        buf_grow(buf, len);
+        if (!buf_reserve(buf, buf->len + len))
+          {
+             buf->data[buf->len] = '\0';
+             goto done;
+          }
+
         vsnprintf(buf->data + buf->len, len + 1, fmt, ap2);
-        buf->len += len;
      }
 
+   buf->len += len;
+
+done:
    va_end(ap2);
    va_end(ap);
 }
 
-const char *
-buf_string_get(buf_t *buf)
+ssize_t
+buf_read_fd(buf_t *buf, int fd, ssize_t max)
 {
-   if (!buf->len)
+   ssize_t want, spare, bytes;
+   int pending = 0;
+
+   if (ioctl(fd, FIONREAD, &pending) == -1 || pending < 0)
+     pending = 0;
+
+   /* Fill the free space, growing only for more pending than fits in it. */
+   spare = buf->size - buf->len - 1;
+   want = pending > spare ? pending : spare;
+   if (!want)
+     want = BUF_READ_SIZE;
+   if (max > 0 && want > max)
+     want = max;
+
+   if (!buf_reserve(buf, buf->len + want))
      {
-        buf->data = strdup("");
-        buf->len = 0;
-        return buf->data;
+        errno = ENOMEM;
+        return -1;
      }
 
+   do
+     bytes = read(fd, buf->data + buf->len, want);
+   while (bytes < 0 && errno == EINTR);
+
+   if (bytes > 0)
+     buf->len += bytes;
+
+   buf->data[buf->len] = '\0';
+
+   return bytes;
+}
+
+ssize_t
+buf_read_all(buf_t *buf, int fd)
+{
+   struct stat st;
+   ssize_t bytes, total = 0;
+
+   /* Room for the whole file and the read that finds its end. */
+   if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0)
+     buf_reserve(buf, buf->len + st.st_size + 1);
+
+   while ((bytes = buf_read_fd(buf, fd, 0)) > 0)
+     total += bytes;
+
+   if (bytes < 0)
+     return -1;
+
+   return total;
+}
+
+const char *
+buf_string_get(buf_t *buf)
+{
    buf->data[buf->len] = '\0';
 
    return buf->data;
@@ -90,15 +215,38 @@ buf_trim(buf_t *buf, ssize_t start)
 void
 buf_reset(buf_t *buf)
 {
-   free(buf->data);
-   buf->data = NULL;
    buf->len = 0;
 }
 
+char *
+buf_detach(buf_t *buf)
+{
+   char *data;
+
+   buf->data[buf->len] = '\0';
+
+   if (buf->data == buf->inline_data)
+     {
+        data = malloc(buf->len + 1);
+        if (!data)
+          return NULL;
+        memcpy(data, buf->inline_data, buf->len + 1);
+     }
+   else
+     {
+        data = buf->data;
+     }
+
+   buf_init(buf);
+
+   return data;
+}
+
 void
 buf_free(buf_t *buf)
 {
-   free(buf->data);
+   if (buf->data != buf->inline_data)
+     free(buf->data);
    free(buf);
 }
 
@@ -15,14 +15,36 @@
  *
  * Manipulate buffers.
  *
+ * A buffer tracks the size of its allocation separately from the length of
+ * its contents and doubles the allocation whenever it runs out, so a
+ * buffer built from many small appends reallocates only a logarithmic
+ * number of times. There is always room for a terminating NULL character
+ * after the contents. Use buf_reserve() when the final length is known.
+ *
+ * Contents up to BUF_INLINE_SIZE bytes are kept inside the buf_t itself
+ * and only move to the heap once they outgrow it. A buf_t can also live on
+ * the stack or inside another structure by setting it up with buf_init()
+ * and releasing it with buf_clear(), so building a short path or header
+ * allocates nothing at all. As the inline contents are part of it, a buf_t
+ * must not be copied by value.
+ *
  */
 
+#include <stdbool.h>
 #include <unistd.h>
 
+/* Bytes of contents, including the terminating NULL, held without allocating. */
+#define BUF_INLINE_SIZE 128
+
+/* Bytes read at once from a descriptor that gives no hint of what is pending. */
+#define BUF_READ_SIZE 16384
+
 typedef struct _buf_t
 {
    ssize_t len;
+   ssize_t size;
    char   *data;
+   char    inline_data[BUF_INLINE_SIZE];
 } buf_t;
 
 /**
@@ -33,15 +55,47 @@ typedef struct _buf_t
 buf_t *
 buf_new(void);
 
+/**
+ * Initialize a buffer in storage owned by the caller, such as the stack.
+ *
+ * @param buf The buffer to initialize.
+ */
+void
+buf_init(buf_t *buf);
+
+/**
+ * Free the contents of a buffer set up with buf_init(), leaving it empty.
+ *
+ * The buffer may be used again afterwards.
+ *
+ * @param buf The buffer to clear.
+ */
+void
+buf_clear(buf_t *buf);
+
 /**
  * Increase the capacity of the buffer.
  *
+ * Makes sure len more bytes and a terminating NULL character fit after the
+ * current contents, at least doubling the allocation if it has to grow.
+ *
  * @param buf The buffer to increase capacity of.
  * @param len The number of bytes to increase and grow the buffer by.
  */
 void
 buf_grow(buf_t *buf, ssize_t len);
 
+/**
+ * Make sure the buffer can hold a total number of bytes without growing.
+ *
+ * @param buf The buffer to reserve space in.
+ * @param size The total length of contents the buffer should hold, a terminating NULL character is accounted for.
+ *
+ * @return True on success, false if memory could not be allocated.
+ */
+bool
+buf_reserve(buf_t *buf, ssize_t size);
+
 /**
  * Append data to the buffer.
  *
@@ -71,6 +125,36 @@ buf_append(buf_t *buf, const char *string);
 void
 buf_append_printf(buf_t *buf, const char *fmt, ...);
 
+/**
+ * Read once from a descriptor straight into the free space of the buffer.
+ *
+ * The read fills the free space of the buffer, which only grows when the
+ * descriptor reports more bytes pending (FIONREAD) than fit, or by
+ * BUF_READ_SIZE when it is full and there is no hint.
+ *
+ * @param buf The buffer to read into.
+ * @param fd The descriptor to read from.
+ * @param max The most bytes to read, 0 for no limit.
+ *
+ * @return The number of bytes read, 0 on end of file or -1 on error with errno set.
+ */
+ssize_t
+buf_read_fd(buf_t *buf, int fd, ssize_t max);
+
+/**
+ * Read from a descriptor until end of file, appending everything to the buffer.
+ *
+ * A regular file is sized with fstat() first so it is read without the
+ * buffer growing on the way.
+ *
+ * @param buf The buffer to read into.
+ * @param fd The blocking descriptor to read from.
+ *
+ * @return The number of bytes read or -1 on error with errno set, the bytes read before it stay in the buffer.
+ */
+ssize_t
+buf_read_all(buf_t *buf, int fd);
+
 /**
  * Return a valid NULL terminated string of the buffer.
  *
@@ -91,11 +175,25 @@ buf_trim(buf_t *buf, ssize_t start);
 /**
  * Reset the buffer to it's initial state for new usage.
  *
+ * The allocation is kept so the buffer can be refilled without growing.
+ *
  * @param buf The buffer to reset.
  */
 void
 buf_reset(buf_t *buf);
 
+/**
+ * Hand the contents over to the caller as a string, leaving the buffer empty.
+ *
+ * Heap contents are returned without copying, inline contents are copied.
+ *
+ * @param buf The buffer to take the contents of.
+ *
+ * @return A NULL terminated string to release with free() or NULL on failure.
+ */
+char *
+buf_detach(buf_t *buf);
+
 /**
  * Free the contents of the buf_t buffer.
  *
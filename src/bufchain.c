@@ -0,0 +1,482 @@
+#include "bufchain.h"
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#if defined(__linux__)
+# include <sys/sendfile.h>
+#endif
+
+struct _bufchain_seg_t
+{
+   int              refs;
+   int              fd;
+   off_t            offset;
+   const char      *data;
+   size_t           len;
+   size_t           size;
+   bufchain_free_cb free_cb;
+   char             inline_data[];
+};
+
+bufchain_t *
+bufchain_new(void)
+{
+   return calloc(1, sizeof(bufchain_t));
+}
+
+bufchain_seg_t *
+bufchain_seg_new(const void *data, size_t len, bufchain_free_cb free_cb)
+{
+   bufchain_seg_t *seg = calloc(1, sizeof(bufchain_seg_t));
+   if (!seg)
+     return NULL;
+
+   seg->refs = 1;
+   seg->fd = -1;
+   seg->data = data;
+   seg->len = len;
+   seg->free_cb = free_cb;
+
+   return seg;
+}
+
+bufchain_seg_t *
+bufchain_seg_file_new(int fd, off_t offset, size_t len)
+{
+   bufchain_seg_t *seg;
+
+   if (fd < 0 || offset < 0)
+     return NULL;
+
+   seg = bufchain_seg_new(NULL, len, NULL);
+   if (!seg)
+     return NULL;
+
+   seg->fd = fd;
+   seg->offset = offset;
+
+   return seg;
+}
+
+/* A segment holding its own copy of data, with room to take more. */
+static bufchain_seg_t *
+_seg_copy_new(const void *data, size_t len)
+{
+   size_t size = len < BUFCHAIN_COPY_SIZE ? BUFCHAIN_COPY_SIZE : len;
+   bufchain_seg_t *seg;
+
+   if (size > SIZE_MAX - sizeof(bufchain_seg_t))
+     return NULL;
+
+   seg = malloc(sizeof(bufchain_seg_t) + size);
+   if (!seg)
+     return NULL;
+
+   memcpy(seg->inline_data, data, len);
+
+   seg->refs = 1;
+   seg->fd = -1;
+   seg->offset = 0;
+   seg->data = seg->inline_data;
+   seg->len = len;
+   seg->size = size;
+   seg->free_cb = NULL;
+
+   return seg;
+}
+
+bufchain_seg_t *
+bufchain_seg_ref(bufchain_seg_t *seg)
+{
+   __atomic_add_fetch(&seg->refs, 1, __ATOMIC_RELAXED);
+
+   return seg;
+}
+
+void
+bufchain_seg_unref(bufchain_seg_t *seg)
+{
+   if (!seg || __atomic_sub_fetch(&seg->refs, 1, __ATOMIC_ACQ_REL))
+     return;
+
+   if (seg->free_cb)
+     seg->free_cb((void *) seg->data);
+
+   free(seg);
+}
+
+/* Add an entry to the chain, the chain takes over the caller's reference. */
+static bool
+_ent_push(bufchain_t *chain, bufchain_seg_t *seg, size_t off, size_t len)
+{
+   bufchain_ent_t *ents;
+   size_t size;
+
+   if (chain->count == chain->size && chain->head)
+     {
+        memmove(chain->ents, chain->ents + chain->head, (chain->count - chain->head) * sizeof(bufchain_ent_t));
+        chain->count -= chain->head;
+        chain->head = 0;
+     }
+
+   if (chain->count == chain->size)
+     {
+        size = chain->size ? chain->size << 1 : 16;
+        ents = realloc(chain->ents, size * sizeof(bufchain_ent_t));
+        if (!ents)
+          return false;
+
+        chain->ents = ents;
+        chain->size = size;
+     }
+
+   chain->ents[chain->count++] = (bufchain_ent_t) { seg, off, len };
+   chain->len += len;
+
+   return true;
+}
+
+bool
+bufchain_append_seg(bufchain_t *chain, bufchain_seg_t *seg, size_t off, size_t len)
+{
+   if (off > seg->len || len > seg->len - off)
+     return false;
+
+   if (!len)
+     return true;
+
+   if (!_ent_push(chain, bufchain_seg_ref(seg), off, len))
+     {
+        bufchain_seg_unref(seg);
+        return false;
+     }
+
+   return true;
+}
+
+bool
+bufchain_append_static(bufchain_t *chain, const void *data, size_t len)
+{
+   return bufchain_append_ref(chain, (void *) data, len, NULL);
+}
+
+bool
+bufchain_append_ref(bufchain_t *chain, void *data, size_t len, bufchain_free_cb free_cb)
+{
+   bufchain_seg_t *seg;
+
+   if (!len)
+     {
+        if (free_cb)
+          free_cb(data);
+        return true;
+     }
+
+   seg = bufchain_seg_new(data, len, free_cb);
+   if (!seg)
+     return false;
+
+   if (!_ent_push(chain, seg, 0, len))
+     {
+        free(seg);
+        return false;
+     }
+
+   return true;
+}
+
+bool
+bufchain_append_copy(bufchain_t *chain, const void *data, size_t len)
+{
+   bufchain_ent_t *last;
+   bufchain_seg_t *seg;
+
+   if (!len)
+     return true;
+
+   /* Join the copy at the end of the chain if nothing else shares it. */
+   if (chain->count > chain->head)
+     {
+        last = &chain->ents[chain->count - 1];
+        seg = last->seg;
+        if (seg->size && seg->refs == 1 && last->off + last->len == seg->len &&
+            seg->size - seg->len >= len)
+          {
+             memcpy(seg->inline_data + seg->len, data, len);
+             seg->len += len;
+             last->len += len;
+             chain->len += len;
+             return true;
+          }
+     }
+
+   seg = _seg_copy_new(data, len);
+   if (!seg)
+     return false;
+
+   if (!_ent_push(chain, seg, 0, len))
+     {
+        free(seg);
+        return false;
+     }
+
+   return true;
+}
+
+bool
+bufchain_append_string(bufchain_t *chain, const char *string)
+{
+   return bufchain_append_copy(chain, string, strlen(string));
+}
+
+bool
+bufchain_append_file(bufchain_t *chain, int fd, off_t offset, size_t len)
+{
+   bufchain_seg_t *seg;
+
+   if (!len)
+     return true;
+
+   seg = bufchain_seg_file_new(fd, offset, len);
+   if (!seg)
+     return false;
+
+   if (!_ent_push(chain, seg, 0, len))
+     {
+        free(seg);
+        return false;
+     }
+
+   return true;
+}
+
+size_t
+bufchain_len(bufchain_t *chain)
+{
+   return chain->len;
+}
+
+ssize_t
+bufchain_peek(bufchain_t *chain, const char **data)
+{
+   bufchain_ent_t *ent;
+   size_t len;
+   ssize_t bytes;
+
+   if (chain->head == chain->count)
+     return 0;
+
+   ent = &chain->ents[chain->head];
+   if (ent->seg->fd == -1)
+     {
+        *data = ent->seg->data + ent->off;
+        return ent->len;
+     }
+
+   if (!chain->scratch)
+     {
+        chain->scratch = malloc(BUFCHAIN_READ_SIZE);
+        if (!chain->scratch)
+          return -1;
+     }
+
+   len = ent->len < BUFCHAIN_READ_SIZE ? ent->len : BUFCHAIN_READ_SIZE;
+
+   bytes = pread(ent->seg->fd, chain->scratch, len, ent->seg->offset + ent->off);
+   if (bytes <= 0)
+     {
+        if (!bytes)
+          errno = EIO;
+        return -1;
+     }
+
+   *data = chain->scratch;
+
+   return bytes;
+}
+
+ssize_t
+bufchain_copy(bufchain_t *chain, void *dest, size_t len)
+{
+   bufchain_ent_t *ent;
+   char *out = dest;
+   size_t done = 0, n, got;
+   ssize_t bytes;
+
+   for (size_t i = chain->head; i < chain->count && done < len; i++)
+     {
+        ent = &chain->ents[i];
+        n = ent->len < len - done ? ent->len : len - done;
+
+        if (ent->seg->fd == -1)
+          {
+             memcpy(out + done, ent->seg->data + ent->off, n);
+             done += n;
+             continue;
+          }
+
+        for (got = 0; got < n; got += bytes)
+          {
+             bytes = pread(ent->seg->fd, out + done + got, n - got, ent->seg->offset + ent->off + got);
+             if (bytes <= 0)
+               {
+                  if (!bytes)
+                    errno = EIO;
+                  else if (errno == EINTR)
+                    {
+                       bytes = 0;
+                       continue;
+                    }
+                  return -1;
+               }
+          }
+
+        done += n;
+     }
+
+   return done;
+}
+
+void
+bufchain_consume(bufchain_t *chain, size_t len)
+{
+   bufchain_ent_t *ent;
+
+   while (len && chain->head < chain->count)
+     {
+        ent = &chain->ents[chain->head];
+        if (len < ent->len)
+          {
+             ent->off += len;
+             ent->len -= len;
+             chain->len -= len;
+             break;
+          }
+
+        len -= ent->len;
+        chain->len -= ent->len;
+        bufchain_seg_unref(ent->seg);
+        chain->head++;
+     }
+
+   if (chain->head == chain->count)
+     chain->head = chain->count = 0;
+}
+
+/* Gather the memory segments at the start of the chain, stopping at a file. */
+static int
+_iov_fill(bufchain_t *chain, struct iovec *iov)
+{
+   bufchain_ent_t *ent;
+   int count = 0;
+
+   for (size_t i = chain->head; i < chain->count && count < BUFCHAIN_IOV_MAX; i++)
+     {
+        ent = &chain->ents[i];
+        if (ent->seg->fd != -1)
+          break;
+
+        iov[count].iov_base = (char *) ent->seg->data + ent->off;
+        iov[count].iov_len = ent->len;
+        count++;
+     }
+
+   return count;
+}
+
+ssize_t
+bufchain_writev(bufchain_t *chain, int fd)
+{
+   struct iovec iov[BUFCHAIN_IOV_MAX];
+   const char *data;
+   ssize_t bytes;
+   int count;
+
+   if (chain->head == chain->count)
+     return 0;
+
+   count = _iov_fill(chain, iov);
+   if (count)
+     {
+        bytes = writev(fd, iov, count);
+     }
+   else
+     {
+#if defined(__linux__)
+        bufchain_ent_t *ent = &chain->ents[chain->head];
+        off_t offset = ent->seg->offset + ent->off;
+
+        bytes = sendfile(fd, ent->seg->fd, &offset, ent->len);
+        if (bytes < 0 && (errno == EINVAL || errno == ENOSYS))
+#endif
+          {
+             bytes = bufchain_peek(chain, &data);
+             if (bytes > 0)
+               bytes = write(fd, data, bytes);
+          }
+     }
+
+   if (bytes > 0)
+     bufchain_consume(chain, bytes);
+
+   return bytes;
+}
+
+ssize_t
+bufchain_sendmsg(bufchain_t *chain, int sock, int flags)
+{
+   struct iovec iov[BUFCHAIN_IOV_MAX];
+   struct msghdr msg = { 0 };
+   const char *data;
+   ssize_t bytes;
+   int count;
+
+   if (chain->head == chain->count)
+     return 0;
+
+   count = _iov_fill(chain, iov);
+   if (count)
+     {
+        msg.msg_iov = iov;
+        msg.msg_iovlen = count;
+        bytes = sendmsg(sock, &msg, flags);
+     }
+   else
+     {
+        bytes = bufchain_peek(chain, &data);
+        if (bytes > 0)
+          bytes = send(sock, data, bytes, flags);
+     }
+
+   if (bytes > 0)
+     bufchain_consume(chain, bytes);
+
+   return bytes;
+}
+
+void
+bufchain_reset(bufchain_t *chain)
+{
+   for (size_t i = chain->head; i < chain->count; i++)
+     bufchain_seg_unref(chain->ents[i].seg);
+
+   chain->head = chain->count = chain->len = 0;
+}
+
+void
+bufchain_free(bufchain_t *chain)
+{
+   if (!chain)
+     return;
+
+   bufchain_reset(chain);
+
+   free(chain->ents);
+   free(chain->scratch);
+   free(chain);
+}
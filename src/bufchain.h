@@ -0,0 +1,287 @@
+#ifndef __BUFCHAIN_H__
+#define __BUFCHAIN_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+/**
+ * @file
+ * @brief These routines are for building output from segments without copying it.
+ */
+
+/* Most segments handed to a single writev() or sendmsg(). */
+#define BUFCHAIN_IOV_MAX 64
+
+/* Room a copied segment makes so later small copies can join it. */
+#define BUFCHAIN_COPY_SIZE 256
+
+/* Bytes of a file region read at once when it can't be sent directly. */
+#define BUFCHAIN_READ_SIZE 16384
+
+/**
+ * @brief Segmented output buffer.
+ * @defgroup BufChain
+ *
+ * @{
+ *
+ * A chain is an ordered list of references to segments of memory or
+ * files that is written out with scatter/gather I/O, so a response made of
+ * a header, a static body and a file region goes out in one writev() or
+ * sendmsg() call without first being copied into one contiguous buffer.
+ *
+ * Segments are reference counted. Static data and memory owned by the
+ * caller are referenced in place, memory handed over with a release
+ * callback is released once the last chain referencing it is done with it,
+ * and a bufchain_seg_t can be shared by any number of chains. Only small
+ * pieces appended with bufchain_append_copy() are copied, consecutive ones
+ * into the same segment.
+ *
+ * Writes may be partial. The chain remembers how far it got, the next
+ * write carries on from there and fully written segments are released.
+ *
+ * File regions are read with pread() from a descriptor that stays owned by
+ * the caller. On Linux they are sent with sendfile() when flushed to a
+ * descriptor.
+ *
+ */
+typedef struct _bufchain_seg_t bufchain_seg_t;
+
+typedef void (*bufchain_free_cb)(void *data);
+
+typedef struct _bufchain_ent_t
+{
+   bufchain_seg_t *seg;
+   size_t          off;
+   size_t          len;
+} bufchain_ent_t;
+
+typedef struct _bufchain_t
+{
+   bufchain_ent_t *ents;
+   size_t          head;
+   size_t          count;
+   size_t          size;
+   size_t          len;
+   char           *scratch;
+} bufchain_t;
+
+/**
+ * Create a new empty chain.
+ *
+ * @return A pointer to the newly created chain or NULL on failure.
+ */
+bufchain_t *
+bufchain_new(void);
+
+/**
+ * Create a reference counted segment of memory to share between chains.
+ *
+ * The segment starts with one reference held by the caller.
+ *
+ * @param data The memory the segment refers to.
+ * @param len The length of the memory in bytes.
+ * @param free_cb Called with data once the last reference is dropped, may be NULL for static memory.
+ *
+ * @return A pointer to the new segment or NULL on failure.
+ */
+bufchain_seg_t *
+bufchain_seg_new(const void *data, size_t len, bufchain_free_cb free_cb);
+
+/**
+ * Create a reference counted segment referring to a region of a file.
+ *
+ * @param fd The descriptor to read from with pread(), it is never closed by the segment.
+ * @param offset The offset of the region within the file.
+ * @param len The length of the region in bytes.
+ *
+ * @return A pointer to the new segment or NULL on failure.
+ */
+bufchain_seg_t *
+bufchain_seg_file_new(int fd, off_t offset, size_t len);
+
+/**
+ * Take another reference to a segment.
+ *
+ * @param seg The segment.
+ *
+ * @return The segment.
+ */
+bufchain_seg_t *
+bufchain_seg_ref(bufchain_seg_t *seg);
+
+/**
+ * Drop a reference to a segment, releasing it with the last one.
+ *
+ * @param seg The segment.
+ */
+void
+bufchain_seg_unref(bufchain_seg_t *seg);
+
+/**
+ * Append part of a segment to a chain, which takes its own reference.
+ *
+ * @param chain The chain to append to.
+ * @param seg The segment.
+ * @param off The offset of the part within the segment.
+ * @param len The length of the part in bytes.
+ *
+ * @return True on success, false on failure or if the part lies outside the segment.
+ */
+bool
+bufchain_append_seg(bufchain_t *chain, bufchain_seg_t *seg, size_t off, size_t len);
+
+/**
+ * Append memory that outlives the chain, such as a string literal, without copying.
+ *
+ * @param chain The chain to append to.
+ * @param data The memory to reference.
+ * @param len The length of the memory in bytes.
+ *
+ * @return True on success, false on failure.
+ */
+bool
+bufchain_append_static(bufchain_t *chain, const void *data, size_t len);
+
+/**
+ * Append memory to a chain without copying, handing its ownership over.
+ *
+ * @param chain The chain to append to.
+ * @param data The memory to reference.
+ * @param len The length of the memory in bytes.
+ * @param free_cb Called with data once it has been written or the chain is freed.
+ *
+ * @return True on success, false on failure in which case data is not released.
+ */
+bool
+bufchain_append_ref(bufchain_t *chain, void *data, size_t len, bufchain_free_cb free_cb);
+
+/**
+ * Append a copy of a small piece of memory to a chain.
+ *
+ * @param chain The chain to append to.
+ * @param data The memory to copy.
+ * @param len The length of the memory in bytes.
+ *
+ * @return True on success, false on failure.
+ */
+bool
+bufchain_append_copy(bufchain_t *chain, const void *data, size_t len);
+
+/**
+ * Append a copy of a string to a chain.
+ *
+ * @param chain The chain to append to.
+ * @param string The string to copy, without its terminating NULL character.
+ *
+ * @return True on success, false on failure.
+ */
+bool
+bufchain_append_string(bufchain_t *chain, const char *string);
+
+/**
+ * Append a region of a file to a chain.
+ *
+ * @param chain The chain to append to.
+ * @param fd The descriptor to read from, it must stay open until the region is written.
+ * @param offset The offset of the region within the file.
+ * @param len The length of the region in bytes.
+ *
+ * @return True on success, false on failure.
+ */
+bool
+bufchain_append_file(bufchain_t *chain, int fd, off_t offset, size_t len);
+
+/**
+ * Return the number of bytes waiting to be written.
+ *
+ * @param chain The chain to query.
+ *
+ * @return The number of bytes.
+ */
+size_t
+bufchain_len(bufchain_t *chain);
+
+/**
+ * Return the next contiguous run of bytes waiting to be written.
+ *
+ * For writers without scatter/gather support such as TLS. File regions
+ * are read into memory owned by the chain, valid until the next call.
+ *
+ * @param chain The chain to query.
+ * @param data Set to the start of the bytes.
+ *
+ * @return The number of bytes at data, zero if the chain is empty and -1 if a file region can't be read.
+ */
+ssize_t
+bufchain_peek(bufchain_t *chain, const char **data);
+
+/**
+ * Copy bytes from the start of a chain without consuming them.
+ *
+ * For writers that need the data in one piece, such as a websocket frame.
+ * Nothing is consumed, so the chain is unchanged whatever happens next.
+ *
+ * @param chain The chain to copy from.
+ * @param dest Where to copy the bytes to.
+ * @param len The most bytes to copy.
+ *
+ * @return The number of bytes copied or -1 if a file region can't be read, with errno set.
+ */
+ssize_t
+bufchain_copy(bufchain_t *chain, void *dest, size_t len);
+
+/**
+ * Mark bytes at the start of a chain as written, releasing finished segments.
+ *
+ * @param chain The chain.
+ * @param len The number of bytes written.
+ */
+void
+bufchain_consume(bufchain_t *chain, size_t len);
+
+/**
+ * Write as much of a chain as a descriptor accepts with one writev().
+ *
+ * A file region at the start of the chain is written on its own instead.
+ *
+ * @param chain The chain to write.
+ * @param fd The descriptor to write to.
+ *
+ * @return The number of bytes written, which have been consumed, or -1 on error with errno set.
+ */
+ssize_t
+bufchain_writev(bufchain_t *chain, int fd);
+
+/**
+ * Send as much of a chain as a socket accepts with one sendmsg().
+ *
+ * @param chain The chain to send.
+ * @param sock The socket to send to.
+ * @param flags Flags passed to sendmsg(), such as MSG_NOSIGNAL.
+ *
+ * @return The number of bytes sent, which have been consumed, or -1 on error with errno set.
+ */
+ssize_t
+bufchain_sendmsg(bufchain_t *chain, int sock, int flags);
+
+/**
+ * Release every segment of a chain, leaving it empty for reuse.
+ *
+ * @param chain The chain to empty.
+ */
+void
+bufchain_reset(bufchain_t *chain);
+
+/**
+ * Free a chain, releasing its segments.
+ *
+ * @param chain The chain to free.
+ */
+void
+bufchain_free(bufchain_t *chain);
+
+/**
+ * @}
+ */
+#endif
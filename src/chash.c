@@ -0,0 +1,122 @@
+#include "chash.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static chash_stripe_t *
+_chash_stripe(chash_t *chash, const char *key)
+{
+   uint64_t hash = hash_bytes(key, strlen(key), chash->seed);
+
+   return &chash->stripes[(hash >> 32) & chash->mask];
+}
+
+chash_t *
+chash_new(unsigned int stripes)
+{
+   chash_t *chash;
+   unsigned int i, count = 1;
+
+   if (!stripes)
+     stripes = CHASH_STRIPES_DEFAULT;
+
+   while (count < stripes)
+     count <<= 1;
+
+   chash = calloc(1, sizeof(chash_t));
+   if (!chash)
+     return NULL;
+
+   if (posix_memalign((void **) &chash->stripes, sizeof(chash_stripe_t), count * sizeof(chash_stripe_t)))
+     {
+        free(chash);
+        return NULL;
+     }
+
+   chash->mask = count - 1;
+
+   for (i = 0; i < count; i++)
+     {
+        spinlock_init(&chash->stripes[i].lock);
+        chash->stripes[i].table = NULL;
+     }
+
+   for (i = 0; i < count; i++)
+     {
+        chash->stripes[i].table = hash_new();
+        if (!chash->stripes[i].table)
+          {
+             chash_free(chash);
+             return NULL;
+          }
+     }
+
+   /* The stripe tables are seeded at random already, borrow one. */
+   chash->seed = chash->stripes[0].table->seed;
+
+   return chash;
+}
+
+void
+chash_add(chash_t *chash, const char *key, void *data)
+{
+   chash_stripe_t *stripe = _chash_stripe(chash, key);
+
+   spinlock_take(&stripe->lock);
+   hash_add(stripe->table, key, data);
+   spinlock_release(&stripe->lock);
+}
+
+void
+chash_del(chash_t *chash, const char *key)
+{
+   chash_stripe_t *stripe = _chash_stripe(chash, key);
+
+   spinlock_take(&stripe->lock);
+   hash_del(stripe->table, key);
+   spinlock_release(&stripe->lock);
+}
+
+void *
+chash_find(chash_t *chash, const char *key)
+{
+   chash_stripe_t *stripe;
+   void *data;
+
+   if (!key) return NULL;
+
+   stripe = _chash_stripe(chash, key);
+
+   spinlock_take(&stripe->lock);
+   data = hash_find(stripe->table, key);
+   spinlock_release(&stripe->lock);
+
+   return data;
+}
+
+size_t
+chash_count(chash_t *chash)
+{
+   size_t count = 0;
+
+   for (unsigned int i = 0; i <= chash->mask; i++)
+     count += __atomic_load_n(&chash->stripes[i].table->count, __ATOMIC_RELAXED);
+
+   return count;
+}
+
+void
+chash_free(chash_t *chash)
+{
+   for (unsigned int i = 0; i <= chash->mask; i++)
+     {
+        chash_stripe_t *stripe = &chash->stripes[i];
+
+        if (stripe->table)
+          hash_free(stripe->table);
+        spinlock_destroy(&stripe->lock);
+     }
+
+   free(chash->stripes);
+   free(chash);
+}
@@ -0,0 +1,110 @@
+#ifndef __CHASH_H__
+#define __CHASH_H__
+
+#include "hash.h"
+#include "thread.h"
+
+/**
+ * @file
+ * @brief These routines are for using a hash table shared between threads.
+ */
+
+/* Stripes used when chash_new() is given zero. */
+#define CHASH_STRIPES_DEFAULT 64
+
+/**
+ * @brief Concurrent hash table.
+ * @defgroup CHash
+ *
+ * @{
+ *
+ * A hash table safe to use from many threads at once.
+ *
+ * Keys are spread over a power of two number of stripes, each an ordinary
+ * hash_t guarded by its own spinlock. Threads touching different stripes
+ * never wait on each other, so throughput scales with the number of cores
+ * rather than being serialized behind a single lock.
+ *
+ */
+typedef struct _chash_stripe_t
+{
+   spinlock_t lock;
+   hash_t    *table;
+} __attribute__((aligned(64))) chash_stripe_t;
+
+typedef struct _chash_t
+{
+   chash_stripe_t *stripes;
+   unsigned int    mask;
+   uint64_t        seed;
+} chash_t;
+
+/**
+ * Create a new concurrent hash table.
+ *
+ * @param stripes The number of independently locked stripes, rounded up to a power of two. Zero uses CHASH_STRIPES_DEFAULT.
+ *
+ * @return A pointer to the newly created hash table or NULL on failure.
+ */
+chash_t *
+chash_new(unsigned int stripes);
+
+/**
+ * Add data to a concurrent hash table.
+ *
+ * If the key already exists its data is freed and replaced.
+ *
+ * @param chash The hash table to add to.
+ * @param key The key used to identify the entry in the hash table.
+ * @param data The data to add to the hash table.
+ */
+void
+chash_add(chash_t *chash, const char *key, void *data);
+
+/**
+ * Delete an item within a concurrent hash table identified by key.
+ *
+ * @param chash The hash table to remove an item from.
+ * @param key The key to identify the data to be removed within the hash table.
+ */
+void
+chash_del(chash_t *chash, const char *key);
+
+/**
+ * Find an item within a concurrent hash table identified by its key.
+ *
+ * The returned data is owned by the table, the caller must make sure no
+ * other thread deletes or replaces the key while the data is in use.
+ *
+ * @param chash The hash table to search within.
+ * @param key The key to identify the item within the hash table.
+ *
+ * @return A pointer to the item if found or NULL if not.
+ */
+void *
+chash_find(chash_t *chash, const char *key);
+
+/**
+ * Return the number of items within a concurrent hash table.
+ *
+ * The count is only exact while no other thread is modifying the table.
+ *
+ * @param chash The hash table to query.
+ *
+ * @return The number of items stored.
+ */
+size_t
+chash_count(chash_t *chash);
+
+/**
+ * Free the whole concurrent hash table and its members.
+ *
+ * @param chash The hash table to free.
+ */
+void
+chash_free(chash_t *chash);
+
+/**
+ * @}
+ */
+#endif
@@ -0,0 +1,464 @@
+#include "ctree.h"
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * A node's version is odd while a writer holds its lock and changes it.
+ * Readers use it like a seqlock: read the version, read the node, then
+ * check the version again.
+ */
+static inline void
+_cpu_relax(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+   __builtin_ia32_pause();
+#elif defined(__aarch64__)
+   __asm__ __volatile__("yield");
+#endif
+}
+
+static inline uint64_t
+_read_lock(ctree_node_t *node)
+{
+   uint64_t version;
+
+   while ((version = __atomic_load_n(&node->version, __ATOMIC_ACQUIRE)) & 1)
+     _cpu_relax();
+
+   return version;
+}
+
+/* Whether a node read since _read_lock() returned version is consistent. */
+static inline bool
+_read_check(ctree_node_t *node, uint64_t version)
+{
+   __atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+   return __atomic_load_n(&node->version, __ATOMIC_RELAXED) == version;
+}
+
+/* Lock a node for writing, failing if it changed since version was read. */
+static inline bool
+_write_lock(ctree_node_t *node, uint64_t version)
+{
+   spinlock_take(&node->lock);
+
+   if (__atomic_load_n(&node->version, __ATOMIC_RELAXED) != version)
+     {
+        spinlock_release(&node->lock);
+        return false;
+     }
+
+   __atomic_store_n(&node->version, version + 1, __ATOMIC_RELAXED);
+   __atomic_thread_fence(__ATOMIC_RELEASE);
+
+   return true;
+}
+
+static inline void
+_write_unlock(ctree_node_t *node)
+{
+   __atomic_store_n(&node->version, node->version + 1, __ATOMIC_RELEASE);
+   spinlock_release(&node->lock);
+}
+
+static ctree_node_t *
+_node_new(bool leaf)
+{
+   ctree_node_t *node;
+
+   if (posix_memalign((void **) &node, 64, sizeof(ctree_node_t)))
+     return NULL;
+
+   memset(node, 0, sizeof(ctree_node_t));
+
+   for (int i = 0; i < CTREE_KEYS; i++)
+     node->keys[i] = SIZE_MAX;
+
+   spinlock_init(&node->lock);
+   node->leaf = leaf;
+
+   return node;
+}
+
+/*
+ * Searches may run over a node a writer is changing, so the count is read
+ * once and clamped. Whatever they return is only used once validated.
+ */
+static inline unsigned int
+_node_count(const ctree_node_t *node)
+{
+   unsigned int count = __atomic_load_n(&node->count, __ATOMIC_RELAXED);
+
+   return count < CTREE_KEYS ? count : CTREE_KEYS;
+}
+
+static inline unsigned int
+_node_lower(const ctree_node_t *node, size_t key)
+{
+   unsigned int n = 0;
+
+   for (int i = 0; i < CTREE_KEYS; i++)
+     n += node->keys[i] < key;
+
+   return n;
+}
+
+static inline unsigned int
+_node_upper(const ctree_node_t *node, size_t key)
+{
+   unsigned int n = 0, count = _node_count(node);
+
+   for (int i = 0; i < CTREE_KEYS; i++)
+     n += node->keys[i] <= key;
+
+   return n < count ? n : count;
+}
+
+/* Read lock the root, making sure it was not replaced by a split meanwhile. */
+static ctree_node_t *
+_root_read_lock(ctree_t *tree, uint64_t *version)
+{
+   ctree_node_t *root;
+
+   do
+     {
+        root = __atomic_load_n(&tree->root, __ATOMIC_ACQUIRE);
+        *version = _read_lock(root);
+     }
+   while (__atomic_load_n(&tree->root, __ATOMIC_ACQUIRE) != root);
+
+   return root;
+}
+
+/* Find the leaf that would hold key, read locked at *version. */
+static ctree_node_t *
+_leaf_find(ctree_t *tree, size_t key, uint64_t *version)
+{
+   ctree_node_t *node, *child, *parent;
+   uint64_t parent_version;
+
+restart:
+   node = _root_read_lock(tree, version);
+
+   while (!node->leaf)
+     {
+        parent = node;
+        parent_version = *version;
+
+        /* The child pointer is only safe to follow once the parent checks
+         * out, and the child's version only means anything if the parent
+         * still holds it once that version was read. */
+        child = parent->children[_node_upper(parent, key)];
+        if (!_read_check(parent, parent_version))
+          goto restart;
+
+        node = child;
+        *version = _read_lock(node);
+
+        if (!_read_check(parent, parent_version))
+          goto restart;
+     }
+
+   return node;
+}
+
+ctree_t *
+ctree_new(void)
+{
+   ctree_t *tree = calloc(1, sizeof(ctree_t));
+   if (!tree)
+     return NULL;
+
+   tree->root = _node_new(true);
+   if (!tree->root)
+     {
+        free(tree);
+        return NULL;
+     }
+
+   spinlock_init(&tree->lock);
+
+   return tree;
+}
+
+/* Move the upper half of a full node into right, returning the key that
+ * separates them. */
+static size_t
+_node_split(ctree_node_t *node, ctree_node_t *right)
+{
+   unsigned int i, mid = CTREE_KEYS / 2;
+   size_t sep;
+
+   if (node->leaf)
+     {
+        right->count = CTREE_KEYS - mid;
+        memcpy(right->keys, &node->keys[mid], right->count * sizeof(size_t));
+        memcpy(right->values, &node->values[mid], right->count * sizeof(void *));
+        right->next = node->next;
+        node->next = right;
+        sep = right->keys[0];
+        node->count = mid;
+     }
+   else
+     {
+        /* The middle key moves up rather than being copied. */
+        right->count = CTREE_KEYS - mid - 1;
+        memcpy(right->keys, &node->keys[mid + 1], right->count * sizeof(size_t));
+        memcpy(right->children, &node->children[mid + 1], (right->count + 1) * sizeof(ctree_node_t *));
+        sep = node->keys[mid];
+        node->count = mid;
+     }
+
+   for (i = mid; i < CTREE_KEYS; i++)
+     node->keys[i] = SIZE_MAX;
+
+   return sep;
+}
+
+/*
+ * Split a full node found while descending, locking it and its parent, or
+ * the tree when it is the root. Returns false only when out of memory,
+ * the caller starts over either way.
+ */
+static bool
+_split(ctree_t *tree, ctree_node_t *parent, uint64_t parent_version,
+       ctree_node_t *node, uint64_t version)
+{
+   ctree_node_t *right, *root = NULL;
+   unsigned int pos;
+   size_t sep;
+
+   if (parent)
+     {
+        if (!_write_lock(parent, parent_version))
+          return true;
+     }
+   else
+     {
+        spinlock_take(&tree->lock);
+        if (tree->root != node)
+          {
+             spinlock_release(&tree->lock);
+             return true;
+          }
+     }
+
+   if (!_write_lock(node, version))
+     {
+        if (parent)
+          _write_unlock(parent);
+        else
+          spinlock_release(&tree->lock);
+        return true;
+     }
+
+   right = _node_new(node->leaf);
+   if (!parent)
+     root = _node_new(false);
+
+   if (!right || (!parent && !root))
+     {
+        free(right);
+        free(root);
+        _write_unlock(node);
+        if (parent)
+          _write_unlock(parent);
+        else
+          spinlock_release(&tree->lock);
+        return false;
+     }
+
+   sep = _node_split(node, right);
+
+   if (parent)
+     {
+        pos = _node_upper(parent, sep);
+        memmove(&parent->keys[pos + 1], &parent->keys[pos], (parent->count - pos) * sizeof(size_t));
+        memmove(&parent->children[pos + 2], &parent->children[pos + 1],
+                (parent->count - pos) * sizeof(ctree_node_t *));
+        parent->keys[pos] = sep;
+        parent->children[pos + 1] = right;
+        parent->count++;
+
+        _write_unlock(node);
+        _write_unlock(parent);
+     }
+   else
+     {
+        root->keys[0] = sep;
+        root->children[0] = node;
+        root->children[1] = right;
+        root->count = 1;
+        __atomic_store_n(&tree->root, root, __ATOMIC_RELEASE);
+
+        _write_unlock(node);
+        spinlock_release(&tree->lock);
+     }
+
+   return true;
+}
+
+bool
+ctree_add(ctree_t *tree, size_t key, void *data)
+{
+   ctree_node_t *node, *child, *parent;
+   uint64_t version, parent_version = 0;
+   unsigned int pos;
+
+restart:
+   parent = NULL;
+   node = _root_read_lock(tree, &version);
+
+   while (1)
+     {
+        /* Full nodes are split on the way down so a parent always has
+         * room for the key a split pushes up. */
+        if (_node_count(node) == CTREE_KEYS)
+          {
+             if (!_split(tree, parent, parent_version, node, version))
+               return false;
+             goto restart;
+          }
+
+        if (node->leaf)
+          break;
+
+        child = node->children[_node_upper(node, key)];
+        if (!_read_check(node, version))
+          goto restart;
+
+        parent = node;
+        parent_version = version;
+        node = child;
+        version = _read_lock(node);
+
+        if (!_read_check(parent, parent_version))
+          goto restart;
+     }
+
+   if (!_write_lock(node, version))
+     goto restart;
+
+   pos = _node_lower(node, key);
+   if (pos < node->count && node->keys[pos] == key)
+     {
+        _write_unlock(node);
+        return false;
+     }
+
+   memmove(&node->keys[pos + 1], &node->keys[pos], (node->count - pos) * sizeof(size_t));
+   memmove(&node->values[pos + 1], &node->values[pos], (node->count - pos) * sizeof(void *));
+   node->keys[pos] = key;
+   node->values[pos] = data;
+   node->count++;
+
+   _write_unlock(node);
+
+   __atomic_add_fetch(&tree->count, 1, __ATOMIC_RELAXED);
+
+   return true;
+}
+
+void *
+ctree_find(ctree_t *tree, size_t key)
+{
+   ctree_node_t *leaf;
+   uint64_t version;
+   unsigned int pos;
+   void *found;
+
+   do
+     {
+        leaf = _leaf_find(tree, key, &version);
+
+        pos = _node_lower(leaf, key);
+        found = NULL;
+        if (pos < _node_count(leaf) && leaf->keys[pos] == key)
+          found = leaf->values[pos];
+     }
+   while (!_read_check(leaf, version));
+
+   return found;
+}
+
+size_t
+ctree_range_foreach(ctree_t *tree, size_t lo, size_t hi, ctree_range_cb range_cb, void *data)
+{
+   size_t keys[CTREE_KEYS];
+   void *values[CTREE_KEYS];
+   ctree_node_t *leaf, *next;
+   uint64_t version;
+   unsigned int i, count;
+   size_t visited = 0;
+
+   if (lo > hi)
+     return 0;
+
+   leaf = _leaf_find(tree, lo, &version);
+
+   while (leaf)
+     {
+        count = _node_count(leaf);
+        memcpy(keys, leaf->keys, count * sizeof(size_t));
+        memcpy(values, leaf->values, count * sizeof(void *));
+        next = leaf->next;
+
+        if (!_read_check(leaf, version))
+          {
+             /* Keys only ever move right, resume from the next one due. */
+             leaf = _leaf_find(tree, lo, &version);
+             continue;
+          }
+
+        for (i = 0; i < count; i++)
+          {
+             if (keys[i] < lo)
+               continue;
+             if (keys[i] > hi)
+               return visited;
+
+             visited++;
+             if (range_cb(keys[i], values[i], data) || keys[i] == SIZE_MAX)
+               return visited;
+
+             lo = keys[i] + 1;
+          }
+
+        leaf = next;
+        if (leaf)
+          version = _read_lock(leaf);
+     }
+
+   return visited;
+}
+
+size_t
+ctree_count(ctree_t *tree)
+{
+   return __atomic_load_n(&tree->count, __ATOMIC_RELAXED);
+}
+
+/* Recursion is bounded by the height of the tree. */
+static void
+_node_free(ctree_node_t *node)
+{
+   for (unsigned int i = 0; i < node->count + !node->leaf; i++)
+     {
+        if (node->leaf)
+          free(node->values[i]);
+        else
+          _node_free(node->children[i]);
+     }
+
+   spinlock_destroy(&node->lock);
+   free(node);
+}
+
+void
+ctree_free(ctree_t *tree)
+{
+   _node_free(tree->root);
+   spinlock_destroy(&tree->lock);
+   free(tree);
+}
@@ -0,0 +1,140 @@
+#ifndef __CTREE_H__
+#define __CTREE_H__
+
+/**
+ * @file
+ * @brief These routines are for using an ordered map shared between threads.
+ */
+
+#include "thread.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Keys held by a node. */
+#define CTREE_KEYS 32
+
+/**
+ * @brief Concurrent ordered map.
+ * @defgroup CTree
+ *
+ * @{
+ *
+ * A B+tree mapping size_t keys to data that many threads may use at once.
+ *
+ * Every node pairs a spinlock with a version number. Readers take no
+ * locks: they note a node's version, read it and check the version is
+ * unchanged before trusting what they read, starting over if a writer
+ * got in between. Writers find their leaf the same way and lock only the
+ * nodes they change, a full node being split on the way down together
+ * with its parent. Lookups therefore never wait on each other and scale
+ * with the number of cores.
+ *
+ * Nodes are never freed while the tree is in use, so a reader holding a
+ * node that was changed under it still reads valid memory. Items cannot
+ * be removed.
+ *
+ */
+
+typedef struct _ctree_node_t ctree_node_t;
+struct _ctree_node_t
+{
+   size_t         keys[CTREE_KEYS];
+   uint64_t       version;
+   spinlock_t     lock;
+   unsigned int   count;
+   bool           leaf;
+   ctree_node_t  *next;
+   union
+   {
+      ctree_node_t *children[CTREE_KEYS + 1];
+      void         *values[CTREE_KEYS];
+   };
+};
+
+typedef struct _ctree_t
+{
+   ctree_node_t *root;
+   spinlock_t    lock;
+   size_t        count;
+} ctree_t;
+
+typedef int (ctree_range_cb)(size_t key, void *value, void *data);
+
+/**
+ * Create a new concurrent ordered map.
+ *
+ * @return A pointer to the newly created map or NULL on failure.
+ */
+ctree_t *
+ctree_new(void);
+
+/**
+ * Add an item to a concurrent ordered map.
+ *
+ * If the key is already within the map nothing is added and the caller
+ * keeps ownership of data.
+ *
+ * @param tree The map to add to.
+ * @param key The key used to index the data.
+ * @param data The data to be stored within the map.
+ *
+ * @return True if the item was added, false if the key exists or on failure.
+ */
+bool
+ctree_add(ctree_t *tree, size_t key, void *data);
+
+/**
+ * Find an item within a concurrent ordered map by its key.
+ *
+ * @param tree The map to search within.
+ * @param key The key of the data within the map.
+ *
+ * @return A pointer to the data stored within the map or NULL if not found.
+ */
+void *
+ctree_find(ctree_t *tree, size_t key);
+
+/**
+ * Visit the items of a concurrent ordered map with keys from lo to hi inclusive, in order.
+ *
+ * Each leaf is copied and validated before its items are passed on, so
+ * the callback never sees a half written leaf. Items added during the
+ * scan may or may not be visited.
+ *
+ * @param tree The map to scan.
+ * @param lo The smallest key to visit.
+ * @param hi The largest key to visit.
+ * @param range_cb The callback triggered for each item, returning non-zero stops the scan.
+ * @param data User data to pass to the callback.
+ *
+ * @return The number of items visited.
+ */
+size_t
+ctree_range_foreach(ctree_t *tree, size_t lo, size_t hi, ctree_range_cb range_cb, void *data);
+
+/**
+ * Return the number of items within a concurrent ordered map.
+ *
+ * @param tree The map to query.
+ *
+ * @return The number of items stored.
+ */
+size_t
+ctree_count(ctree_t *tree);
+
+/**
+ * Free the whole concurrent ordered map including all data.
+ *
+ * No other thread may be using the map.
+ *
+ * @param tree The map to free.
+ */
+void
+ctree_free(ctree_t *tree);
+
+/**
+ * @}
+ */
+
+#endif
@@ -11,32 +11,24 @@ char *
 exe_response(const char *command)
 {
    FILE *p;
-   buf_t *lines;
-   char *output;
-   char buf[8192];
+   buf_t lines;
+   char *output = NULL;
 
    p = popen(command, "r");
    if (!p)
      return NULL;
 
-   lines = buf_new();
+   buf_init(&lines);
 
-   while ((fgets(buf, sizeof(buf), p)) != NULL)
-     {
-        buf_append(lines, buf);
-     }
+   /* Read the pipe straight into the buffer and hand its contents over. */
+   buf_read_all(&lines, fileno(p));
 
    pclose(p);
 
-   if (lines->len == 0)
-     {
-        buf_free(lines);
-        return NULL;
-     }
-
-   output = strdup(buf_string_get(lines));
+   if (lines.len > 0)
+     output = buf_detach(&lines);
 
-   buf_free(lines);
+   buf_clear(&lines);
 
    return output;
 }
@@ -7,6 +7,7 @@
 #include <string.h>
 #include <dirent.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <openssl/sha.h>
 
 bool
@@ -63,32 +64,23 @@ file_filename_get(const char *path)
 buf_t *
 file_contents_get(const char *path)
 {
-   FILE *f;
    buf_t *buf;
-   ssize_t size, block_size = 1024;
+   int fd;
 
-   f = fopen(path, "r");
-   if (!f)
+   fd = open(path, O_RDONLY);
+   if (fd == -1)
      return NULL;
 
    buf = buf_new();
 
-   size = file_size_get(path);
-   if (size > 0)
-     {
-        buf_grow(buf, block_size);
-        buf->len += fread(buf->data, 1, block_size, f);
-     }
-
-   while (!feof(f) && !ferror(f))
+   /* Read straight into the buffer, sized for the whole file up front. */
+   if (buf && buf_read_all(buf, fd) < 0)
      {
-        buf_grow(buf, block_size);
-        buf->len += fread(buf->data + buf->len, 1, block_size, f);
+        buf_free(buf);
+        buf = NULL;
      }
 
-   buf_grow(buf, 0);
-
-   fclose(f);
+   close(fd);
 
    return buf;
 }
@@ -112,51 +104,103 @@ file_stat(const char *path)
    return s;
 }
 
-list_t *
-file_stat_ls(const char *directory)
+array_t *
+file_stat_ls_array(const char *directory)
 {
    DIR *dir;
    struct dirent *ent;
-   buf_t *path;
-   list_t *files;
+   buf_t path;
+   array_t *files;
 
    dir = opendir(directory);
    if (!dir) return NULL;
 
-   files = list_new();
+   files = array_new(sizeof(stat_t));
+   if (!files)
+     {
+        closedir(dir);
+        return NULL;
+     }
 
-   path = buf_new();
+   buf_init(&path);
 
    while ((ent = readdir(dir)) != NULL)
      {
         if (!strcmp(ent->d_name, ".") || !strcmp(ent->d_name, ".."))
           continue;
 
-        buf_reset(path);
-        buf_append_printf(path, "%s/%s", directory, ent->d_name);
+        buf_reset(&path);
+        buf_append_printf(&path, "%s/%s", directory, ent->d_name);
         struct stat st;
-        if (stat(buf_string_get(path), &st) < 0)
+        if (stat(buf_string_get(&path), &st) < 0)
           {
              continue;
           }
 
-        stat_t *s = malloc(sizeof(stat_t));
+        stat_t *s = array_push(files);
+        if (!s)
+          break;
+
         s->filename = strdup(ent->d_name);
         s->size = st.st_size;
         s->mode = st.st_mode;
         s->inode = st.st_ino;
         s->ctime = st.st_ctime;
         s->mtime = st.st_mtime;
-
-        files = list_add(files, s);
      }
 
-   buf_free(path);
+   buf_clear(&path);
    closedir(dir);
 
    return files;
 }
 
+void
+file_stat_ls_array_free(array_t *files)
+{
+   stat_t *st;
+   size_t i;
+
+   if (!files) return;
+
+   ARRAY_FOREACH(files, i, st)
+     {
+        free(st->filename);
+     }
+
+   array_free(files);
+}
+
+list_t *
+file_stat_ls(const char *directory)
+{
+   array_t *files;
+   list_head_t list;
+   stat_t *st, *s;
+   size_t i;
+
+   files = file_stat_ls_array(directory);
+   if (!files) return NULL;
+
+   list_head_init(&list);
+
+   ARRAY_FOREACH(files, i, st)
+     {
+        s = malloc(sizeof(stat_t));
+        if (!s || !list_head_append(&list, s))
+          {
+             free(s);
+             free(st->filename);
+             continue;
+          }
+        *s = *st;
+     }
+
+   array_free(files);
+
+   return list_head_steal(&list);
+}
+
 void
 file_stat_ls_free(list_t *files)
 {
@@ -175,23 +219,35 @@ file_stat_ls_free(list_t *files)
      }
 }
 
-list_t *
-file_ls(const char *directory)
+array_t *
+file_ls_array(const char *directory)
 {
    DIR *dir;
    struct dirent *ent;
-   list_t *files;
+   array_t *files;
+   char *name;
 
    dir = opendir(directory);
    if (!dir) return NULL;
 
-   files = list_new();
+   files = array_new(sizeof(char *));
+   if (!files)
+     {
+        closedir(dir);
+        return NULL;
+     }
 
    while ((ent = readdir(dir)) != NULL)
      {
         if (!strcmp(ent->d_name, ".") || !strcmp(ent->d_name, ".."))
           continue;
-        files = list_add(files, strdup(ent->d_name));
+
+        name = strdup(ent->d_name);
+        if (!name || !array_append(files, &name))
+          {
+             free(name);
+             break;
+          }
      }
 
    closedir(dir);
@@ -199,6 +255,46 @@ file_ls(const char *directory)
    return files;
 }
 
+void
+file_ls_array_free(array_t *files)
+{
+   char **name;
+   size_t i;
+
+   if (!files) return;
+
+   ARRAY_FOREACH(files, i, name)
+     {
+        free(*name);
+     }
+
+   array_free(files);
+}
+
+list_t *
+file_ls(const char *directory)
+{
+   array_t *files;
+   list_head_t list;
+   char **name;
+   size_t i;
+
+   files = file_ls_array(directory);
+   if (!files) return NULL;
+
+   list_head_init(&list);
+
+   ARRAY_FOREACH(files, i, name)
+     {
+        if (!list_head_append(&list, *name))
+          free(*name);
+     }
+
+   array_free(files);
+
+   return list_head_steal(&list);
+}
+
 bool
 file_mkdir(const char *path)
 {
@@ -215,8 +311,9 @@ file_mkdir(const char *path)
 bool
 file_directory_is_empty(const char *path)
 {
-   list_t *files;
+   array_t *files;
    struct stat st;
+   bool empty;
 
    if (stat(path, &st) < 0)
      return false;
@@ -224,14 +321,15 @@ file_directory_is_empty(const char *path)
    if (!S_ISDIR(st.st_mode))
      return false;
 
-   files = file_ls(path);
-   if (files)
-     {
-        list_free(files);
-        return false;
-     }
+   files = file_ls_array(path);
+   if (!files)
+     return true;
 
-   return true;
+   empty = array_count(files) == 0;
+
+   file_ls_array_free(files);
+
+   return empty;
 }
 
 bool
@@ -314,34 +412,35 @@ file_remove_all(const char *path)
 void
 file_path_walk(const char *directory, file_path_walk_cb path_walk_cb, void *data)
 {
-   buf_t *path;
+   buf_t path;
    stat_t *st;
+   size_t i;
 
-   path = buf_new();
+   array_t *files = file_stat_ls_array(directory);
+   if (!files)
+     return;
 
-   list_t *l, *files = file_stat_ls(directory);
-   l = files;
-   while (l)
+   buf_init(&path);
+
+   ARRAY_FOREACH(files, i, st)
      {
-        st = l->data;
         if (strcmp(st->filename, ".") && strcmp(st->filename, ".."))
           {
-             buf_reset(path);
-             buf_append_printf(path, "%s/%s", directory, st->filename);
+             buf_reset(&path);
+             buf_append_printf(&path, "%s/%s", directory, st->filename);
 
-             if (file_is_directory(buf_string_get(path)))
+             if (file_is_directory(buf_string_get(&path)))
                {
-                  file_path_walk(buf_string_get(path), path_walk_cb, data);
+                  file_path_walk(buf_string_get(&path), path_walk_cb, data);
                }
 
-             path_walk_cb(buf_string_get(path), st, data);
+             path_walk_cb(buf_string_get(&path), st, data);
           }
-        l = l->next;
      }
 
-   buf_free(path);
+   buf_clear(&path);
 
-   file_stat_ls_free(files);
+   file_stat_ls_array_free(files);
 }
 
 bool
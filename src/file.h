@@ -6,6 +6,7 @@
  * @brief These routines are used for file interaction.
  */
 
+#include "array.h"
 #include "list.h"
 #include "buf.h"
 #include <unistd.h>
@@ -131,6 +132,45 @@ file_stat_ls(const char *directory);
 void
 file_stat_ls_free(list_t *files);
 
+/**
+ * Read all files in a directory and return an array of their names.
+ *
+ * @param directory The directory to read the file list from.
+ *
+ * @return An array of (char *) names, free with file_ls_array_free(), or NULL if the directory can't be read.
+ */
+array_t *
+file_ls_array(const char *directory);
+
+/**
+ * Free an array returned by file_ls_array() and its names.
+ *
+ * @param files The array to free.
+ */
+void
+file_ls_array_free(array_t *files);
+
+/**
+ * Read all files in a directory and return an array of stat_t entries.
+ *
+ * The entries are stored inline, only their filenames are allocated
+ * separately.
+ *
+ * @param directory The directory to read the file list from.
+ *
+ * @return An array of stat_t, free with file_stat_ls_array_free(), or NULL if the directory can't be read.
+ */
+array_t *
+file_stat_ls_array(const char *directory);
+
+/**
+ * Free an array returned by file_stat_ls_array() and its filenames.
+ *
+ * @param files The array to free.
+ */
+void
+file_stat_ls_array_free(array_t *files);
+
 /**
  * Create directory at given location.
  *
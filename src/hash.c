@@ -5,195 +5,1440 @@
 #include <stdbool.h>
 #include <stdarg.h>
 #include <string.h>
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
 
-static uint32_t
-hashish(const char *s)
+#if !defined(HASH_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64))
+# include <emmintrin.h>
+# define HASH_SSE2 1
+#elif !defined(HASH_NO_SIMD) && (defined(__ARM_NEON) || defined(__aarch64__))
+# include <arm_neon.h>
+# define HASH_NEON 1
+#endif
+
+/*
+ * Control bytes. A full slot stores the low 7 bits of its hash (H2) so the
+ * high bit tells empty/deleted slots apart from live ones.
+ */
+#define CTRL_EMPTY   0x80
+#define CTRL_DELETED 0xfe
+
+#define CTRL_IS_FULL(c) (((c) & 0x80) == 0)
+
+/*
+ * A match mask has one set bit per matching slot of a group. NEON has no
+ * movemask so its masks use a nibble per slot, HASH_MASK_SHIFT converts a
+ * bit index back to a slot index.
+ */
+#if defined(HASH_NEON)
+typedef uint64_t hash_mask_t;
+# define HASH_MASK_ALL   0xffffffffffffffffull
+# define HASH_MASK_SHIFT 2
+# define HASH_MASK_LOWEST(m) ((m) & 0x8888888888888888ull)
+# define HASH_MASK_CTZ(m)    __builtin_ctzll(m)
+#else
+typedef uint32_t hash_mask_t;
+# define HASH_MASK_ALL   0xffffu
+# define HASH_MASK_SHIFT 0
+# define HASH_MASK_LOWEST(m) (m)
+# define HASH_MASK_CTZ(m)    __builtin_ctz(m)
+#endif
+
+#define HASH_MASK_FOREACH(_mask, _i) \
+        for (_mask = HASH_MASK_LOWEST(_mask); \
+             _mask && ((_i = HASH_MASK_CTZ(_mask) >> HASH_MASK_SHIFT), 1); \
+             _mask &= _mask - 1)
+
+#if defined(HASH_SSE2)
+
+static inline hash_mask_t
+_group_match(const uint8_t *ctrl, uint8_t h2)
+{
+   __m128i group = _mm_loadu_si128((const __m128i *) ctrl);
+
+   return _mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8((char) h2)));
+}
+
+static inline hash_mask_t
+_group_match_empty(const uint8_t *ctrl)
+{
+   return _group_match(ctrl, CTRL_EMPTY);
+}
+
+static inline hash_mask_t
+_group_match_free(const uint8_t *ctrl)
+{
+   return _mm_movemask_epi8(_mm_loadu_si128((const __m128i *) ctrl));
+}
+
+#elif defined(HASH_NEON)
+
+static inline hash_mask_t
+_neon_mask(uint8x16_t cmp)
+{
+   uint8x8_t nibbles = vshrn_n_u16(vreinterpretq_u16_u8(cmp), 4);
+
+   return vget_lane_u64(vreinterpret_u64_u8(nibbles), 0);
+}
+
+static inline hash_mask_t
+_group_match(const uint8_t *ctrl, uint8_t h2)
+{
+   return _neon_mask(vceqq_u8(vld1q_u8(ctrl), vdupq_n_u8(h2)));
+}
+
+static inline hash_mask_t
+_group_match_empty(const uint8_t *ctrl)
+{
+   return _group_match(ctrl, CTRL_EMPTY);
+}
+
+static inline hash_mask_t
+_group_match_free(const uint8_t *ctrl)
+{
+   return _neon_mask(vcltq_s8(vreinterpretq_s8_u8(vld1q_u8(ctrl)), vdupq_n_s8(0)));
+}
+
+#else
+
+static inline hash_mask_t
+_group_match(const uint8_t *ctrl, uint8_t h2)
+{
+   hash_mask_t mask = 0;
+
+   for (int i = 0; i < HASH_GROUP_WIDTH; i++)
+     mask |= (hash_mask_t) (ctrl[i] == h2) << i;
+
+   return mask;
+}
+
+static inline hash_mask_t
+_group_match_empty(const uint8_t *ctrl)
+{
+   return _group_match(ctrl, CTRL_EMPTY);
+}
+
+static inline hash_mask_t
+_group_match_free(const uint8_t *ctrl)
+{
+   hash_mask_t mask = 0;
+
+   for (int i = 0; i < HASH_GROUP_WIDTH; i++)
+     mask |= (hash_mask_t) (ctrl[i] >> 7) << i;
+
+   return mask;
+}
+
+#endif
+
+static inline hash_mask_t
+_group_match_full(const uint8_t *ctrl)
+{
+   return _group_match_free(ctrl) ^ HASH_MASK_ALL;
+}
+
+/*
+ * String hashing follows wyhash (final version 4): 8 byte reads folded
+ * with 64x64->128 bit multiplies, 48 bytes per round on long keys.
+ */
+static const uint64_t _wyp[4] =
+{
+   0x2d358dccaa6c78a5ull, 0x8bb84b93962eacc9ull,
+   0x4b33a62ed433d4a3ull, 0x4d5a2da51de1aa47ull
+};
+
+static inline void
+_wymum(uint64_t *a, uint64_t *b)
+{
+#if defined(__SIZEOF_INT128__)
+   __uint128_t r = *a;
+
+   r *= *b;
+   *a = (uint64_t) r;
+   *b = (uint64_t) (r >> 64);
+#else
+   uint64_t ha = *a >> 32, hb = *b >> 32, la = (uint32_t) *a, lb = (uint32_t) *b;
+   uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+   uint64_t t = rl + (rm0 << 32), c = t < rl, lo, hi;
+
+   lo = t + (rm1 << 32);
+   c += lo < t;
+   hi = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+   *a = lo;
+   *b = hi;
+#endif
+}
+
+static inline uint64_t
+_wymix(uint64_t a, uint64_t b)
+{
+   _wymum(&a, &b);
+
+   return a ^ b;
+}
+
+static inline uint64_t
+_wyr8(const uint8_t *p)
+{
+   uint64_t v;
+
+   memcpy(&v, p, sizeof(v));
+
+   return v;
+}
+
+static inline uint64_t
+_wyr4(const uint8_t *p)
 {
-   const char *p = s;
-   uint32_t res = 0;
+   uint32_t v;
 
-   while (*p)
+   memcpy(&v, p, sizeof(v));
+
+   return v;
+}
+
+static inline uint64_t
+_wyr3(const uint8_t *p, size_t k)
+{
+   return ((uint64_t) p[0] << 16) | ((uint64_t) p[k >> 1] << 8) | p[k - 1];
+}
+
+static uint64_t
+hashish(const void *key, size_t len, uint64_t seed)
+{
+   const uint8_t *p = key;
+   uint64_t a, b;
+
+   seed ^= _wymix(seed ^ _wyp[0], _wyp[1]);
+
+   if (len <= 16)
+     {
+        if (len >= 4)
+          {
+             a = (_wyr4(p) << 32) | _wyr4(p + ((len >> 3) << 2));
+             b = (_wyr4(p + len - 4) << 32) | _wyr4(p + len - 4 - ((len >> 3) << 2));
+          }
+        else if (len > 0)
+          {
+             a = _wyr3(p, len);
+             b = 0;
+          }
+        else
+          {
+             a = b = 0;
+          }
+     }
+   else
      {
-        res *= (uint32_t)*p + 101;
-        p++;
+        size_t i = len;
+
+        if (i >= 48)
+          {
+             uint64_t see1 = seed, see2 = seed;
+             do
+               {
+                  seed = _wymix(_wyr8(p) ^ _wyp[1], _wyr8(p + 8) ^ seed);
+                  see1 = _wymix(_wyr8(p + 16) ^ _wyp[2], _wyr8(p + 24) ^ see1);
+                  see2 = _wymix(_wyr8(p + 32) ^ _wyp[3], _wyr8(p + 40) ^ see2);
+                  p += 48;
+                  i -= 48;
+               }
+             while (i >= 48);
+
+             seed ^= see1 ^ see2;
+          }
+
+        while (i > 16)
+          {
+             seed = _wymix(_wyr8(p) ^ _wyp[1], _wyr8(p + 8) ^ seed);
+             i -= 16;
+             p += 16;
+          }
+
+        a = _wyr8(p + i - 16);
+        b = _wyr8(p + i - 8);
      }
 
-   return res % TABLE_SIZE;
+   a ^= _wyp[1];
+   b ^= seed;
+   _wymum(&a, &b);
+
+   return _wymix(a ^ _wyp[0] ^ len, b ^ _wyp[1]);
 }
 
-struct hash_t **
-hash_new(void)
+static pthread_once_t _hash_secret_once = PTHREAD_ONCE_INIT;
+static uint64_t _hash_secret;
+static uint64_t _hash_counter;
+
+static void
+_hash_secret_init(void)
 {
-   int i;
-   struct hash_t **hashtable = malloc(TABLE_SIZE * sizeof(struct hash_t *));
+#if defined(__OpenBSD__) || defined(__FreeBSD__) || defined(__DragonFly__) || (defined(__APPLE__) && defined(__MACH__))
+   arc4random_buf(&_hash_secret, sizeof(_hash_secret));
+#else
+   int fd = open("/dev/urandom", O_RDONLY | O_CLOEXEC);
+   if (fd != -1)
+     {
+        if (read(fd, &_hash_secret, sizeof(_hash_secret)) != sizeof(_hash_secret))
+          _hash_secret = 0;
+        close(fd);
+     }
 
-   for (i = 0; i < TABLE_SIZE; i++)
+   if (!_hash_secret)
      {
-        hashtable[i] = NULL;
+        struct timespec ts;
+
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        _hash_secret = _wymix((uint64_t) ts.tv_nsec ^ _wyp[2],
+                              (uint64_t) ts.tv_sec ^ ((uint64_t) getpid() << 32));
      }
+#endif
+}
 
-   return hashtable;
+/*
+ * Every table gets its own seed so key sets crafted to collide in one
+ * table (or one process) do not carry over to another.
+ */
+static uint64_t
+_hash_seed_new(const hash_t *hashtable)
+{
+   uint64_t n;
+
+   pthread_once(&_hash_secret_once, _hash_secret_init);
+
+   n = __atomic_add_fetch(&_hash_counter, 1, __ATOMIC_RELAXED);
+
+   return _wymix(_hash_secret ^ _wyp[0], n ^ (uintptr_t) hashtable ^ _wyp[3]);
 }
 
-void
-hash_free(struct hash_t **hashtable)
+#define HASH_H1(h) ((h) >> 7)
+#define HASH_H2(h) ((uint8_t) ((h) & 0x7f))
+
+/*
+ * Groups are visited in triangular steps, which covers every group of a
+ * power of two sized table.
+ */
+typedef struct _probe_t
+{
+   size_t mask;
+   size_t group;
+   size_t step;
+} probe_t;
+
+static inline void
+_probe_init(probe_t *probe, size_t size, uint64_t hash)
+{
+   probe->mask = (size / HASH_GROUP_WIDTH) - 1;
+   probe->group = HASH_H1(hash) & probe->mask;
+   probe->step = 0;
+}
+
+static inline void
+_probe_next(probe_t *probe)
+{
+   probe->step++;
+   probe->group = (probe->group + probe->step) & probe->mask;
+}
+
+/*
+ * Saved tables are laid out as a header, the control bytes and an entry
+ * per slot, followed by the key and value strings the entries refer to by
+ * offset from the start of the file. An offset of zero is a NULL value.
+ */
+#define HASH_FILE_MAGIC   "SEAHASH"
+#define HASH_FILE_VERSION 1
+#define HASH_FILE_ORDER   0x01020304u
+
+typedef struct _hash_file_header_t
+{
+   char     magic[8];
+   uint32_t version;
+   uint32_t order;
+   uint64_t seed;
+   uint64_t size;
+   uint64_t count;
+   uint64_t strings;
+   uint64_t reserved[2];
+} hash_file_header_t;
+
+typedef struct _hash_file_entry_t
+{
+   uint64_t hash;
+   uint64_t key;
+   uint64_t len;
+   uint64_t data;
+} hash_file_entry_t;
+
+static inline const hash_file_entry_t *
+_hash_file_entries(const hash_t *hashtable)
+{
+   return (const hash_file_entry_t *) ((const char *) hashtable->map +
+                                       sizeof(hash_file_header_t) + hashtable->size);
+}
+
+static inline char *
+_hash_file_string(const hash_t *hashtable, uint64_t offset, uint64_t len)
+{
+   if (!offset || offset > hashtable->map_size || len >= hashtable->map_size - offset)
+     return NULL;
+
+   return (char *) hashtable->map + offset;
+}
+
+static inline uint64_t
+_hash_entry_hash(const hash_t *hashtable, size_t idx)
 {
-   for (int i = 0; i < TABLE_SIZE; i++)
+   if (hashtable->map)
+     return _hash_file_entries(hashtable)[idx].hash;
+
+   return hashtable->entries[idx].hash;
+}
+
+static inline char *
+_hash_entry_key(const hash_t *hashtable, size_t idx)
+{
+   if (hashtable->map)
+     {
+        const hash_file_entry_t *entry = &_hash_file_entries(hashtable)[idx];
+        return _hash_file_string(hashtable, entry->key, entry->len);
+     }
+
+   return hashtable->entries[idx].key;
+}
+
+static inline void *
+_hash_entry_data(const hash_t *hashtable, size_t idx)
+{
+   if (hashtable->map)
+     {
+        const hash_file_entry_t *entry = &_hash_file_entries(hashtable)[idx];
+        return _hash_file_string(hashtable, entry->data, 0);
+     }
+
+   return hashtable->entries[idx].data;
+}
+
+/*
+ * Arena tables copy keys into slabs, keys longer than a slab get a slab of
+ * their own. Interning indexes every key copied by its hash using linear
+ * probing, reusing the hash already computed for the table.
+ */
+#define HASH_SLAB_SIZE (64 * 1024)
+
+typedef struct _hash_slab_t
+{
+   struct _hash_slab_t *next;
+   size_t               used;
+   size_t               size;
+   char                 data[];
+} hash_slab_t;
+
+typedef struct _hash_intern_t
+{
+   char     *key;
+   size_t    len;
+   uint64_t  hash;
+} hash_intern_t;
+
+typedef struct _hash_arena_t
+{
+   hash_slab_t   *slabs;
+   bool           intern;
+   hash_intern_t *interned;
+   size_t         interned_size;
+   size_t         interned_count;
+} hash_arena_t;
+
+static char *
+_hash_arena_alloc(hash_arena_t *arena, size_t len)
+{
+   hash_slab_t *slab = arena->slabs;
+   char *mem;
+
+   if (!slab || slab->size - slab->used < len)
      {
-        struct hash_t *cursor = hashtable[i];
-        while (cursor)
+        size_t size = len > HASH_SLAB_SIZE ? len : HASH_SLAB_SIZE;
+
+        slab = malloc(sizeof(hash_slab_t) + size);
+        if (!slab)
+          return NULL;
+
+        slab->used = 0;
+        slab->size = size;
+
+        /* Keep the slab with the most room at the head. */
+        if (arena->slabs && size == len)
+          {
+             slab->next = arena->slabs->next;
+             arena->slabs->next = slab;
+          }
+        else
           {
-             free(cursor->key);
-             if (cursor->data)
-               free(cursor->data);
-             struct hash_t *next = cursor->bucket_next;
-             free(cursor);
-             cursor = next;
+             slab->next = arena->slabs;
+             arena->slabs = slab;
           }
      }
-   free(hashtable);
+
+   mem = slab->data + slab->used;
+   slab->used += len;
+
+   return mem;
 }
 
-void
-hash_add(struct hash_t **hashtable, const char *key, void *data)
+static bool
+_hash_intern_grow(hash_arena_t *arena)
 {
-   uint32_t index = hashish(key);
+   hash_intern_t *old = arena->interned;
+   size_t i, old_size = arena->interned_size;
+   size_t size = old_size ? old_size << 1 : HASH_SIZE_MIN;
+
+   arena->interned = calloc(size, sizeof(hash_intern_t));
+   if (!arena->interned)
+     {
+        arena->interned = old;
+        return false;
+     }
 
-   struct hash_t *cursor = hashtable[index];
+   arena->interned_size = size;
 
-   if (!cursor)
+   for (i = 0; i < old_size; i++)
      {
-        hashtable[index] = cursor = calloc(1, sizeof(struct hash_t));
-        cursor->key = strdup(key);
-        cursor->data = data;
-        cursor->bucket_next = NULL;
-        return;
+        size_t idx;
+
+        if (!old[i].key)
+          continue;
+
+        idx = HASH_H1(old[i].hash) & (size - 1);
+        while (arena->interned[idx].key)
+          idx = (idx + 1) & (size - 1);
+
+        arena->interned[idx] = old[i];
+     }
+
+   free(old);
+
+   return true;
+}
+
+static char *
+_hash_key_new(hash_t *hashtable, const char *key, size_t len, uint64_t hash)
+{
+   hash_arena_t *arena = hashtable->arena;
+   hash_intern_t *slot = NULL;
+   char *copy;
+
+   if (!arena)
+     copy = malloc(len + 1);
+   else if (!arena->intern)
+     copy = _hash_arena_alloc(arena, len + 1);
+   else
+     {
+        size_t idx, mask;
+
+        if ((arena->interned_count + 1) * 2 > arena->interned_size &&
+            !_hash_intern_grow(arena))
+          return NULL;
+
+        mask = arena->interned_size - 1;
+        for (idx = HASH_H1(hash) & mask; arena->interned[idx].key; idx = (idx + 1) & mask)
+          {
+             slot = &arena->interned[idx];
+             if (slot->hash == hash && slot->len == len && !memcmp(slot->key, key, len))
+               return slot->key;
+          }
+
+        slot = &arena->interned[idx];
+        copy = _hash_arena_alloc(arena, len + 1);
      }
 
-   while (cursor->bucket_next)
-     cursor = cursor->bucket_next;
+   if (!copy)
+     return NULL;
 
-   if (cursor->bucket_next == NULL)
+   memcpy(copy, key, len);
+   copy[len] = '\0';
+
+   if (slot)
      {
-        cursor->bucket_next = calloc(1, sizeof(struct hash_t));
-        cursor = cursor->bucket_next;
-        cursor->key = strdup(key);
-        cursor->data = data;
-        cursor->bucket_next = NULL;
+        slot->key = copy;
+        slot->len = len;
+        slot->hash = hash;
+        arena->interned_count++;
      }
+
+   return copy;
 }
 
-void
-hash_del(struct hash_t **hashtable, const char *key)
+static void
+_hash_key_free(hash_t *hashtable, char *key)
 {
-   uint32_t idx = hashish(key);
-   struct hash_t *tmp = hashtable[idx];
-   if (!tmp)
+   if (!hashtable->arena)
+     free(key);
+}
+
+static void
+_hash_arena_free(hash_arena_t *arena)
+{
+   hash_slab_t *slab, *next;
+
+   for (slab = arena->slabs; slab; slab = next)
+     {
+        next = slab->next;
+        free(slab);
+     }
+
+   free(arena->interned);
+   free(arena);
+}
+
+/* Grow past 7/8 full (counting tombstones), shrink below 1/8 full. */
+static bool
+_hash_is_full(size_t size, size_t used)
+{
+   return used * 8 > size * 7;
+}
+
+static size_t
+_hash_size_for(size_t count)
+{
+   size_t size = HASH_SIZE_MIN;
+
+   while (_hash_is_full(size, count + 1))
+     size <<= 1;
+
+   return size;
+}
+
+/* Find key within one set of slots, either the table's or the old ones. */
+static ssize_t
+_hash_slot_find(const uint8_t *ctrls, const hash_entry_t *entries, size_t size,
+                const char *key, size_t len, uint64_t hash)
+{
+   probe_t probe;
+   uint8_t h2 = HASH_H2(hash);
+
+   _probe_init(&probe, size, hash);
+
+   while (1)
+     {
+        size_t base = probe.group * HASH_GROUP_WIDTH;
+        const uint8_t *ctrl = &ctrls[base];
+        hash_mask_t mask = _group_match(ctrl, h2);
+        unsigned int i;
+
+        HASH_MASK_FOREACH(mask, i)
+          {
+             const hash_entry_t *entry = &entries[base + i];
+
+             if (entry->hash == hash && entry->len == len &&
+                 !memcmp(entry->key, key, len))
+               return base + i;
+          }
+
+        if (_group_match_empty(ctrl))
+          return -1;
+
+        _probe_next(&probe);
+     }
+}
+
+/*
+ * Lookup against a mapped file. The file may be damaged, so keys are
+ * bounds checked and the probe gives up once every group was visited.
+ */
+static ssize_t
+_hash_file_slot_find(hash_t *hashtable, const char *key, size_t len, uint64_t hash)
+{
+   const hash_file_entry_t *entries = _hash_file_entries(hashtable);
+   probe_t probe;
+   uint8_t h2 = HASH_H2(hash);
+
+   _probe_init(&probe, hashtable->size, hash);
+
+   while (probe.step <= probe.mask)
+     {
+        size_t base = probe.group * HASH_GROUP_WIDTH;
+        const uint8_t *ctrl = &hashtable->ctrl[base];
+        hash_mask_t mask = _group_match(ctrl, h2);
+        unsigned int i;
+
+        HASH_MASK_FOREACH(mask, i)
+          {
+             const hash_file_entry_t *entry = &entries[base + i];
+             const char *k;
+
+             if (entry->hash != hash || entry->len != len)
+               continue;
+
+             k = _hash_file_string(hashtable, entry->key, len);
+             if (k && !memcmp(k, key, len))
+               return base + i;
+          }
+
+        if (_group_match_empty(ctrl))
+          return -1;
+
+        _probe_next(&probe);
+     }
+
+   return -1;
+}
+
+/* First empty or deleted slot on the probe sequence of hash. */
+static size_t
+_hash_slot_free(const hash_t *hashtable, uint64_t hash)
+{
+   probe_t probe;
+
+   _probe_init(&probe, hashtable->size, hash);
+
+   while (1)
+     {
+        size_t base = probe.group * HASH_GROUP_WIDTH;
+        hash_mask_t mask = _group_match_free(&hashtable->ctrl[base]);
+        unsigned int i;
+
+        HASH_MASK_FOREACH(mask, i)
+          return base + i;
+
+        _probe_next(&probe);
+     }
+}
+
+/* First live slot at or after index, or the table size if there is none. */
+static size_t
+_hash_slot_next(const hash_t *hashtable, size_t index)
+{
+   while (index < hashtable->size)
+     {
+        size_t base = index & ~(size_t) (HASH_GROUP_WIDTH - 1);
+        hash_mask_t mask = _group_match_full(&hashtable->ctrl[base]);
+        unsigned int i;
+
+        mask &= ~(((hash_mask_t) 1 << ((index - base) << HASH_MASK_SHIFT)) - 1);
+
+        HASH_MASK_FOREACH(mask, i)
+          return base + i;
+
+        index = base + HASH_GROUP_WIDTH;
+     }
+
+   return hashtable->size;
+}
+
+/* Control bytes and entries share one allocation, entries first so the
+ * control bytes stay 16 byte aligned. */
+static bool
+_hash_alloc(hash_t *hashtable, size_t size)
+{
+   char *mem = malloc(size * sizeof(hash_entry_t) + size);
+   if (!mem)
+     return false;
+
+   hashtable->entries = (hash_entry_t *) mem;
+   hashtable->ctrl = (uint8_t *) (mem + size * sizeof(hash_entry_t));
+   hashtable->size = size;
+   hashtable->deleted = 0;
+
+   memset(hashtable->ctrl, CTRL_EMPTY, size);
+
+   return true;
+}
+
+/* Old slots moved over by each add, delete or lookup while resizing. */
+#define HASH_MIGRATE_STEP (HASH_GROUP_WIDTH * 4)
+
+/*
+ * Move up to count old slots into the table, releasing the old slots once
+ * the last live entry has moved.
+ */
+static void
+_hash_migrate(hash_t *hashtable, size_t count)
+{
+   size_t i, end;
+
+   if (!hashtable->old_entries)
      return;
 
-   struct hash_t *last = NULL;
+   end = hashtable->old_size;
+   if (count < end - hashtable->migrated)
+     end = hashtable->migrated + count;
+
+   for (i = hashtable->migrated; i < end && hashtable->old_count; i++)
+     {
+        hash_entry_t *entry = &hashtable->old_entries[i];
+        size_t idx;
+
+        if (!CTRL_IS_FULL(hashtable->old_ctrl[i]))
+          continue;
+
+        idx = _hash_slot_free(hashtable, entry->hash);
+        if (hashtable->ctrl[idx] == CTRL_DELETED)
+          hashtable->deleted--;
+
+        hashtable->ctrl[idx] = HASH_H2(entry->hash);
+        hashtable->entries[idx] = *entry;
+        hashtable->old_count--;
+
+        /* Keep the probe chains of the old slots intact. */
+        hashtable->old_ctrl[i] = CTRL_DELETED;
+     }
+
+   hashtable->migrated = i;
+
+   if (!hashtable->old_count)
+     {
+        free(hashtable->old_entries);
+        hashtable->old_entries = NULL;
+        hashtable->old_ctrl = NULL;
+        hashtable->old_size = hashtable->migrated = 0;
+     }
+}
+
+static bool
+_hash_resize(hash_t *hashtable, size_t size)
+{
+   hash_entry_t *old;
+   uint8_t *old_ctrl;
+   size_t old_size;
+
+   /* Only one resize runs at a time. */
+   _hash_migrate(hashtable, SIZE_MAX);
+
+   old = hashtable->entries;
+   old_ctrl = hashtable->ctrl;
+   old_size = hashtable->size;
+
+   if (!_hash_alloc(hashtable, size))
+     return false;
+
+   hashtable->old_entries = old;
+   hashtable->old_ctrl = old_ctrl;
+   hashtable->old_size = old_size;
+   hashtable->old_count = hashtable->count;
+   hashtable->migrated = 0;
+
+   _hash_migrate(hashtable, HASH_MIGRATE_STEP);
+
+   return true;
+}
+
+/* Find key in the table or, while resizing, in the old slots. */
+static hash_entry_t *
+_hash_entry_find(hash_t *hashtable, const char *key, size_t len, uint64_t hash)
+{
+   ssize_t idx;
+
+   idx = _hash_slot_find(hashtable->ctrl, hashtable->entries, hashtable->size, key, len, hash);
+   if (idx >= 0)
+     return &hashtable->entries[idx];
+
+   if (!hashtable->old_entries)
+     return NULL;
+
+   idx = _hash_slot_find(hashtable->old_ctrl, hashtable->old_entries, hashtable->old_size,
+                         key, len, hash);
+   if (idx >= 0)
+     return &hashtable->old_entries[idx];
+
+   return NULL;
+}
+
+hash_t *
+hash_new_flags(unsigned int flags)
+{
+   hash_t *hashtable = calloc(1, sizeof(hash_t));
+   if (!hashtable)
+     return NULL;
 
-   while (tmp)
+   if (flags & (HASH_ARENA | HASH_INTERN))
      {
-        if (tmp->key && !strcmp(tmp->key, key))
+        hashtable->arena = calloc(1, sizeof(hash_arena_t));
+        if (!hashtable->arena)
           {
-             if (tmp->data)
-               free(tmp->data);
-             if (last)
-               last->bucket_next = tmp->bucket_next;
-             else
-               hashtable[idx] = tmp->bucket_next;
+             free(hashtable);
+             return NULL;
+          }
+        hashtable->arena->intern = !!(flags & HASH_INTERN);
+     }
+
+   if (!_hash_alloc(hashtable, HASH_SIZE_MIN))
+     {
+        free(hashtable->arena);
+        free(hashtable);
+        return NULL;
+     }
+
+   hashtable->seed = _hash_seed_new(hashtable);
+
+   return hashtable;
+}
+
+hash_t *
+hash_new(void)
+{
+   return hash_new_flags(0);
+}
+
+void
+hash_free(hash_t *hashtable)
+{
+   size_t i;
+
+   if (hashtable->map)
+     {
+        munmap(hashtable->map, hashtable->map_size);
+        free(hashtable);
+        return;
+     }
+
+   for (i = _hash_slot_next(hashtable, 0); i < hashtable->size; i = _hash_slot_next(hashtable, i + 1))
+     {
+        hash_entry_t *entry = &hashtable->entries[i];
+
+        _hash_key_free(hashtable, entry->key);
+        if (entry->data)
+          free(entry->data);
+     }
+
+   for (i = hashtable->migrated; hashtable->old_count && i < hashtable->old_size; i++)
+     {
+        hash_entry_t *entry = &hashtable->old_entries[i];
+
+        if (!CTRL_IS_FULL(hashtable->old_ctrl[i]))
+          continue;
+
+        _hash_key_free(hashtable, entry->key);
+        if (entry->data)
+          free(entry->data);
+     }
 
-             if (tmp->key)
-               free(tmp->key);
+   if (hashtable->arena)
+     _hash_arena_free(hashtable->arena);
 
-             free(tmp);
+   free(hashtable->old_entries);
+   free(hashtable->entries);
+   free(hashtable);
+}
+
+void
+hash_add_n(hash_t *hashtable, const char *key, size_t len, void *data)
+{
+   hash_entry_t *entry;
+   uint64_t hash;
+   size_t idx;
+   char *copy;
+
+   if (hashtable->map)
+     return;
+
+   _hash_migrate(hashtable, HASH_MIGRATE_STEP);
 
+   hash = hashish(key, len, hashtable->seed);
+
+   entry = _hash_entry_find(hashtable, key, len, hash);
+   if (entry)
+     {
+        if (entry->data && entry->data != data)
+          free(entry->data);
+        entry->data = data;
+        return;
+     }
+
+   copy = _hash_key_new(hashtable, key, len, hash);
+   if (!copy)
+     return;
+
+   if (_hash_is_full(hashtable->size, hashtable->count + hashtable->deleted + 1))
+     {
+        /* Only double when live entries fill the table, tombstones are
+         * cleared by rehashing at the same size. Leave a quarter to spare
+         * so the migration completes before the next resize is due. */
+        if (!_hash_resize(hashtable, _hash_size_for(hashtable->count + hashtable->count / 4 + 1)))
+          {
+             _hash_key_free(hashtable, copy);
              return;
           }
+     }
+
+   idx = _hash_slot_free(hashtable, hash);
+
+   if (hashtable->ctrl[idx] == CTRL_DELETED)
+     hashtable->deleted--;
+
+   hashtable->ctrl[idx] = HASH_H2(hash);
+   entry = &hashtable->entries[idx];
+   entry->key = copy;
+   entry->len = len;
+   entry->hash = hash;
+   entry->data = data;
+   hashtable->count++;
+}
+
+void
+hash_add(hash_t *hashtable, const char *key, void *data)
+{
+   hash_add_n(hashtable, key, strlen(key), data);
+}
+
+static void
+_hash_slot_del(hash_t *hashtable, size_t idx)
+{
+   hash_entry_t *entry = &hashtable->entries[idx];
+   size_t base;
+
+   if (entry->data)
+     free(entry->data);
+
+   _hash_key_free(hashtable, entry->key);
+
+   entry->key = NULL;
+   entry->data = NULL;
+
+   /*
+    * Groups are aligned, so a probe only ever moved past this group while
+    * it had no empty slot. If one exists now no chain runs through it and
+    * the slot can be emptied rather than left as a tombstone.
+    */
+   base = idx & ~(size_t) (HASH_GROUP_WIDTH - 1);
+   if (_group_match_empty(&hashtable->ctrl[base]))
+     {
+        hashtable->ctrl[idx] = CTRL_EMPTY;
+     }
+   else
+     {
+        hashtable->ctrl[idx] = CTRL_DELETED;
+        hashtable->deleted++;
+     }
+
+   hashtable->count--;
+}
+
+static void
+_hash_shrink(hash_t *hashtable)
+{
+   if (hashtable->old_entries)
+     return;
+
+   if (hashtable->size > HASH_SIZE_MIN && hashtable->count * 8 < hashtable->size)
+     _hash_resize(hashtable, _hash_size_for(hashtable->count));
+}
+
+void
+hash_del_n(hash_t *hashtable, const char *key, size_t len)
+{
+   uint64_t hash;
+   ssize_t idx;
+
+   if (hashtable->map)
+     return;
 
-        last = tmp;
-        tmp = tmp->bucket_next;
+   _hash_migrate(hashtable, HASH_MIGRATE_STEP);
+
+   hash = hashish(key, len, hashtable->seed);
+
+   idx = _hash_slot_find(hashtable->ctrl, hashtable->entries, hashtable->size, key, len, hash);
+   if (idx >= 0)
+     {
+        _hash_slot_del(hashtable, idx);
+        _hash_shrink(hashtable);
+        return;
      }
+
+   if (!hashtable->old_entries)
+     return;
+
+   idx = _hash_slot_find(hashtable->old_ctrl, hashtable->old_entries, hashtable->old_size,
+                         key, len, hash);
+   if (idx < 0)
+     return;
+
+   /* The old slots are dropped once migrated, a tombstone is enough. */
+   _hash_key_free(hashtable, hashtable->old_entries[idx].key);
+   if (hashtable->old_entries[idx].data)
+     free(hashtable->old_entries[idx].data);
+
+   hashtable->old_ctrl[idx] = CTRL_DELETED;
+   hashtable->old_count--;
+   hashtable->count--;
+
+   if (!hashtable->old_count)
+     _hash_migrate(hashtable, 0);
+}
+
+void
+hash_del(hash_t *hashtable, const char *key)
+{
+   hash_del_n(hashtable, key, strlen(key));
 }
 
 void *
-hash_find(struct hash_t **hashtable, const char *key)
+hash_find_n(hash_t *hashtable, const char *key, size_t len)
 {
-   uint32_t idx;
-   struct hash_t *tmp;
+   hash_entry_t *entry;
+   uint64_t hash;
+   ssize_t idx;
 
    if (!key) return NULL;
 
-   idx  = hashish(key);
-   tmp = hashtable[idx];
+   hash = hashish(key, len, hashtable->seed);
 
-   if (!tmp)
+   if (hashtable->map)
      {
-        return NULL;
+        idx = _hash_file_slot_find(hashtable, key, len, hash);
+        if (idx < 0)
+          return NULL;
+
+        return _hash_entry_data(hashtable, idx);
      }
 
-   while (tmp)
+   _hash_migrate(hashtable, HASH_MIGRATE_STEP);
+
+   entry = _hash_entry_find(hashtable, key, len, hash);
+   if (!entry)
+     return NULL;
+
+   return entry->data;
+}
+
+void *
+hash_find(hash_t *hashtable, const char *key)
+{
+   if (!key) return NULL;
+
+   return hash_find_n(hashtable, key, strlen(key));
+}
+
+void
+hash_iter_init(hash_t *hashtable, hash_iter_t *iter)
+{
+   _hash_migrate(hashtable, SIZE_MAX);
+
+   iter->hashtable = hashtable;
+   iter->index = 0;
+   iter->current = hashtable->size;
+   iter->deleted = false;
+}
+
+bool
+hash_iter_next(hash_iter_t *iter, const char **key, void **data)
+{
+   hash_t *hashtable = iter->hashtable;
+   size_t i = _hash_slot_next(hashtable, iter->index);
+
+   if (i >= hashtable->size)
      {
-        if (tmp->key && !strcmp(tmp->key, key))
+        /* Shrinking was held back while deleting through the iterator. */
+        if (iter->deleted)
           {
-             return tmp->data;
+             iter->deleted = false;
+             _hash_shrink(hashtable);
           }
+        iter->current = iter->index = hashtable->size;
+        return false;
+     }
+
+   iter->current = i;
+   iter->index = i + 1;
+
+   if (key)
+     *key = _hash_entry_key(hashtable, i);
+   if (data)
+     *data = _hash_entry_data(hashtable, i);
+
+   return true;
+}
+
+void
+hash_iter_del(hash_iter_t *iter)
+{
+   hash_t *hashtable = iter->hashtable;
+
+   if (hashtable->map)
+     return;
+
+   if (iter->current >= hashtable->size || !CTRL_IS_FULL(hashtable->ctrl[iter->current]))
+     return;
+
+   _hash_slot_del(hashtable, iter->current);
+   iter->deleted = true;
+}
+
+void
+hash_dump(hash_t *hashtable)
+{
+   hash_iter_t iter;
+   const char *key;
+   void *data;
 
-        tmp = tmp->bucket_next;
+   HASH_FOREACH(hashtable, iter, key, data)
+     {
+        if (data)
+          printf("key -> %s data -> %p\n", key, data);
      }
+}
 
-   return NULL;
+bool
+hash_is_empty(hash_t *hashtable)
+{
+   return hashtable->count == 0;
 }
 
 void
-hash_dump(struct hash_t **hashtable)
+hash_stats(hash_t *hashtable, hash_stats_t *stats)
 {
-   for (int i = 0; i < TABLE_SIZE; i++)
+   size_t total = 0;
+
+   _hash_migrate(hashtable, SIZE_MAX);
+
+   memset(stats, 0, sizeof(hash_stats_t));
+
+   stats->count = hashtable->count;
+   stats->size = hashtable->size;
+   stats->deleted = hashtable->deleted;
+   stats->load = (double) hashtable->count / hashtable->size;
+
+   for (size_t i = 0; i < hashtable->size; i++)
      {
-        struct hash_t *cursor = hashtable[i];
-        while (cursor)
+        probe_t probe;
+        size_t length = 1;
+
+        if (!CTRL_IS_FULL(hashtable->ctrl[i]))
+          continue;
+
+        _probe_init(&probe, hashtable->size, _hash_entry_hash(hashtable, i));
+        while (probe.group != i / HASH_GROUP_WIDTH)
           {
-             if (cursor->data)
-               {
-                  printf("key -> %s data -> %p\n",
-                         cursor->key, cursor->data);
-               }
-             cursor = cursor->bucket_next;
+             _probe_next(&probe);
+             length++;
           }
+
+        total += length;
+        if (length > stats->probe_max)
+          stats->probe_max = length;
+
+        if (length > HASH_STATS_PROBES_MAX)
+          length = HASH_STATS_PROBES_MAX;
+        stats->probes[length - 1]++;
      }
+
+   if (hashtable->count)
+     stats->probe_mean = (double) total / hashtable->count;
+}
+
+static bool
+_hash_file_write(FILE *f, const void *data, size_t len)
+{
+   return fwrite(data, 1, len, f) == len;
 }
 
 bool
-hash_is_empty(struct hash_t **hashtable)
+hash_save(hash_t *hashtable, const char *path)
 {
-   for (int i = 0; i < TABLE_SIZE; i++)
+   hash_file_header_t header;
+   hash_file_entry_t *entries;
+   char *tmp;
+   FILE *f;
+   size_t i, len;
+   uint64_t offset;
+   bool ok;
+
+   if (hashtable->map)
+     return false;
+
+   _hash_migrate(hashtable, SIZE_MAX);
+
+   entries = calloc(hashtable->size, sizeof(hash_file_entry_t));
+   if (!entries)
+     return false;
+
+   memset(&header, 0, sizeof(header));
+   memcpy(header.magic, HASH_FILE_MAGIC, sizeof(header.magic));
+   header.version = HASH_FILE_VERSION;
+   header.order = HASH_FILE_ORDER;
+   header.seed = hashtable->seed;
+   header.size = hashtable->size;
+   header.count = hashtable->count;
+
+   offset = sizeof(header) + hashtable->size + hashtable->size * sizeof(hash_file_entry_t);
+
+   for (i = _hash_slot_next(hashtable, 0); i < hashtable->size; i = _hash_slot_next(hashtable, i + 1))
      {
-        struct hash_t *cursor = hashtable[i];
-        if (cursor)
+        hash_entry_t *entry = &hashtable->entries[i];
+
+        entries[i].hash = entry->hash;
+        entries[i].len = entry->len;
+        entries[i].key = offset;
+        offset += entry->len + 1;
+
+        if (entry->data)
+          {
+             entries[i].data = offset;
+             offset += strlen(entry->data) + 1;
+          }
+     }
+
+   header.strings = offset - (sizeof(header) + hashtable->size + hashtable->size * sizeof(hash_file_entry_t));
+
+   len = strlen(path) + 5;
+   tmp = malloc(len);
+   if (!tmp)
+     {
+        free(entries);
+        return false;
+     }
+   snprintf(tmp, len, "%s.tmp", path);
+
+   f = fopen(tmp, "wb");
+   if (!f)
+     {
+        free(entries);
+        free(tmp);
+        return false;
+     }
+
+   ok = _hash_file_write(f, &header, sizeof(header)) &&
+        _hash_file_write(f, hashtable->ctrl, hashtable->size) &&
+        _hash_file_write(f, entries, hashtable->size * sizeof(hash_file_entry_t));
+
+   for (i = _hash_slot_next(hashtable, 0); ok && i < hashtable->size; i = _hash_slot_next(hashtable, i + 1))
+     {
+        hash_entry_t *entry = &hashtable->entries[i];
+
+        ok = _hash_file_write(f, entry->key, entry->len + 1);
+        if (ok && entry->data)
+          ok = _hash_file_write(f, entry->data, strlen(entry->data) + 1);
+     }
+
+   if (fclose(f))
+     ok = false;
+
+   if (ok)
+     ok = !rename(tmp, path);
+
+   if (!ok)
+     unlink(tmp);
+
+   free(entries);
+   free(tmp);
+
+   return ok;
+}
+
+/*
+ * Keys and values of a mapped file are handed out as C strings, so every
+ * one used must end in a NULL character inside the mapping.
+ */
+static bool
+_hash_file_strings_valid(const hash_t *hashtable)
+{
+   const hash_file_entry_t *entries = _hash_file_entries(hashtable);
+   const char *map = hashtable->map, *value;
+
+   for (size_t i = 0; i < hashtable->size; i++)
+     {
+        const hash_file_entry_t *entry = &entries[i];
+
+        if (!CTRL_IS_FULL(hashtable->ctrl[i]))
+          continue;
+
+        if (!_hash_file_string(hashtable, entry->key, entry->len) || map[entry->key + entry->len] != '\0')
+          return false;
+
+        if (!entry->data)
+          continue;
+
+        value = _hash_file_string(hashtable, entry->data, 0);
+        if (!value || !memchr(value, '\0', hashtable->map_size - entry->data))
           return false;
      }
 
    return true;
 }
 
+hash_t *
+hash_mmap_open(const char *path)
+{
+   hash_file_header_t *header;
+   hash_t *hashtable;
+   struct stat st;
+   void *map;
+   uint64_t size;
+   int fd;
+
+   fd = open(path, O_RDONLY | O_CLOEXEC);
+   if (fd == -1)
+     return NULL;
+
+   if (fstat(fd, &st) == -1 || (size_t) st.st_size < sizeof(hash_file_header_t))
+     {
+        close(fd);
+        return NULL;
+     }
+
+   map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+   close(fd);
+   if (map == MAP_FAILED)
+     return NULL;
+
+   header = map;
+   size = header->size;
+
+   if (memcmp(header->magic, HASH_FILE_MAGIC, sizeof(header->magic)) ||
+       header->version != HASH_FILE_VERSION || header->order != HASH_FILE_ORDER ||
+       size < HASH_SIZE_MIN || (size & (size - 1)) ||
+       size > ((uint64_t) st.st_size - sizeof(hash_file_header_t)) / (sizeof(hash_file_entry_t) + 1))
+     {
+        munmap(map, st.st_size);
+        return NULL;
+     }
+
+   hashtable = calloc(1, sizeof(hash_t));
+   if (!hashtable)
+     {
+        munmap(map, st.st_size);
+        return NULL;
+     }
+
+   hashtable->map = map;
+   hashtable->map_size = st.st_size;
+   hashtable->ctrl = (uint8_t *) map + sizeof(hash_file_header_t);
+   hashtable->size = size;
+   hashtable->count = header->count;
+   hashtable->seed = header->seed;
+
+   if (!_hash_file_strings_valid(hashtable))
+     {
+        munmap(map, st.st_size);
+        free(hashtable);
+        return NULL;
+     }
+
+   return hashtable;
+}
+
+uint64_t
+hash_bytes(const void *key, size_t len, uint64_t seed)
+{
+   return hashish(key, len, seed);
+}
+
 char **
 hash_keys_get(hash_t *hashtable)
 {
-   char **keys = malloc(sizeof(char *));
-   int idx = 0, count = 1;
+   char **keys = malloc((hashtable->count + 1) * sizeof(char *));
+   hash_iter_t iter;
+   const char *key;
+   void *data;
+   size_t idx = 0;
 
-   for (int i = 0; i < TABLE_SIZE; i++)
+   HASH_FOREACH(hashtable, iter, key, data)
      {
-        struct hash_t *cursor = hashtable[i];
-        while (cursor)
-          {
-             keys[idx++] = strdup(cursor->key);
-             count++;
-             void *tmp = realloc(keys, count * sizeof(char *));
-             keys = tmp;
-             cursor = cursor->bucket_next;
-          }
+        keys[idx++] = strdup(key);
      }
 
    keys[idx] = NULL;
@@ -213,4 +1458,3 @@ hash_keys_free(char **keys)
    free(keys[i]);
    free(keys);
 }
-
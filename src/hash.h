@@ -2,12 +2,23 @@
 #define __HASH_H__
 
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 
 /**
  * @file
  * @brief These routines are for using a hash table.
  */
-#define TABLE_SIZE 33311
+
+/* Slots compared at once when probing, one SSE2/NEON register. */
+#define HASH_GROUP_WIDTH 16
+
+/* Smallest number of slots a table holds, a power of two >= HASH_GROUP_WIDTH. */
+#define HASH_SIZE_MIN HASH_GROUP_WIDTH
+
+/* Flags for hash_new_flags(). */
+#define HASH_ARENA  (1 << 0)
+#define HASH_INTERN (1 << 1)
 
 /**
  * @brief Hash table manipulation and creation.
@@ -17,15 +28,93 @@
  *
  * Creation and manipulation of a simple hash table.
  *
+ * The table uses open addressing over a single contiguous array of slots.
+ * It starts at HASH_SIZE_MIN slots and doubles or halves as the load
+ * factor crosses its limits, so memory use follows the number of entries
+ * held. Resizing is incremental: the previous slots are kept alongside the
+ * new ones and every add, delete or lookup moves a few more of them over,
+ * so no single call pays for rehashing the whole table.
+ *
+ * Keys are hashed with a 64-bit wyhash style function seeded at random
+ * per table, so collisions can't be precomputed against a running process.
+ *
+ * Each slot has a control byte holding 7 bits of its key's hash (or an
+ * empty/deleted marker). Lookups probe HASH_GROUP_WIDTH control bytes at
+ * a time using SSE2 or NEON where available and compare keys only on a
+ * control byte match. Entries cache their full hash and key length, so
+ * the key bytes are only compared when both of those match too. Define
+ * HASH_NO_SIMD when building the library to
+ * force the portable scalar group match.
+ *
+ * Tables created with HASH_ARENA copy their keys into large slabs owned by
+ * the table rather than allocating each one, so freeing the table releases
+ * the keys with a few calls. The space of a deleted key is only reclaimed
+ * when the table is freed. HASH_INTERN additionally keeps one copy of every
+ * key ever added, so keys that are deleted and added again reuse it.
+ *
+ * A table whose values are strings can be written out with hash_save()
+ * and mapped back read-only with hash_mmap_open(). The file holds the
+ * control bytes and offsets rather than pointers, so lookups run straight
+ * against the mapping and processes mapping the same file share its pages.
+ *
  */
-struct hash_t
+typedef struct _hash_entry_t
 {
-   char   *key;
-   void   *data;
-   struct hash_t *bucket_next;
-};
+   char     *key;
+   void     *data;
+   uint64_t  hash;
+   size_t    len;
+} hash_entry_t;
 
-typedef struct hash_t * hash_t;
+typedef struct _hash_t
+{
+   uint8_t      *ctrl;
+   hash_entry_t *entries;
+   size_t        size;
+   size_t        count;
+   size_t        deleted;
+   uint64_t      seed;
+   void         *map;
+   size_t        map_size;
+   struct _hash_arena_t *arena;
+   uint8_t      *old_ctrl;
+   hash_entry_t *old_entries;
+   size_t        old_size;
+   size_t        old_count;
+   size_t        migrated;
+} hash_t;
+
+/**
+ * Cursor over the entries of a hash table, see HASH_FOREACH.
+ */
+typedef struct _hash_iter_t
+{
+   hash_t *hashtable;
+   size_t  index;
+   size_t  current;
+   bool    deleted;
+} hash_iter_t;
+
+/* Buckets in the probe length histogram of hash_stats_t. */
+#define HASH_STATS_PROBES_MAX 16
+
+/**
+ * Distribution report filled in by hash_stats().
+ *
+ * Probe lengths count the groups visited to reach a key, 1 means it sits
+ * in its home group. probes[n] holds the number of keys needing n + 1
+ * groups, the last bucket also holds anything longer.
+ */
+typedef struct _hash_stats_t
+{
+   size_t count;
+   size_t size;
+   size_t deleted;
+   double load;
+   size_t probe_max;
+   double probe_mean;
+   size_t probes[HASH_STATS_PROBES_MAX];
+} hash_stats_t;
 
 /**
  * Create a new hash table.
@@ -35,9 +124,21 @@ typedef struct hash_t * hash_t;
 hash_t *
 hash_new(void);
 
+/**
+ * Create a new hash table with options.
+ *
+ * @param flags HASH_ARENA to allocate keys from slabs owned by the table, HASH_INTERN to also share repeated keys. HASH_INTERN implies HASH_ARENA.
+ *
+ * @return A pointer to the newly created hash table or NULL on failure.
+ */
+hash_t *
+hash_new_flags(unsigned int flags);
+
 /**
  * Add data to a hash table.
  *
+ * If the key already exists its data is freed and replaced.
+ *
  * @param hashtable The hash table to add to.
  * @param key The key used to identify the entry in the hash table.
  * @param data The data to add to the hash table.
@@ -45,6 +146,19 @@ hash_new(void);
 void
 hash_add(hash_t *hashtable, const char *key, void *data);
 
+/**
+ * Add data to a hash table using a key of explicit length.
+ *
+ * The key need not be NULL terminated, the table stores a terminated copy.
+ *
+ * @param hashtable The hash table to add to.
+ * @param key The key used to identify the entry in the hash table.
+ * @param len The length of the key in bytes.
+ * @param data The data to add to the hash table.
+ */
+void
+hash_add_n(hash_t *hashtable, const char *key, size_t len, void *data);
+
 /**
  * Delete an item within a hash table identified by key.
  *
@@ -54,6 +168,16 @@ hash_add(hash_t *hashtable, const char *key, void *data);
 void
 hash_del(hash_t *hashtable, const char *key);
 
+/**
+ * Delete an item within a hash table identified by a key of explicit length.
+ *
+ * @param hashtable The hash table to remove an item from.
+ * @param key The key to identify the data to be removed within the hash table.
+ * @param len The length of the key in bytes.
+ */
+void
+hash_del_n(hash_t *hashtable, const char *key, size_t len);
+
 /**
  * Find an item within a hash table identified by its key.
  *
@@ -65,6 +189,21 @@ hash_del(hash_t *hashtable, const char *key);
 void *
 hash_find(hash_t *hashtable, const char *key);
 
+/**
+ * Find an item within a hash table identified by a key of explicit length.
+ *
+ * This allows lookups straight from a slice of a larger buffer, such as a
+ * header name inside received data, without copying it first.
+ *
+ * @param hashtable The hash table to search within.
+ * @param key The key to identify the item within the hash table.
+ * @param len The length of the key in bytes.
+ *
+ * @return A pointer to the item if found or NULL if not.
+ */
+void *
+hash_find_n(hash_t *hashtable, const char *key, size_t len);
+
 /**
  * Free the whole hash table structure and its members.
  *
@@ -91,6 +230,103 @@ hash_dump(hash_t *hashtable);
 bool
 hash_is_empty(hash_t *hashtable);
 
+/**
+ * Report the load and probe length distribution of a hash table.
+ *
+ * @param hashtable The hash table to query.
+ * @param stats The report to fill in.
+ */
+void
+hash_stats(hash_t *hashtable, hash_stats_t *stats);
+
+/**
+ * Start iterating over a hash table.
+ *
+ * Iteration allocates nothing and skips empty slots a group at a time. The
+ * order of entries is unspecified. The table must not be added to while
+ * iterating, use hash_iter_del() to remove entries.
+ *
+ * @param hashtable The hash table to iterate over.
+ * @param iter The iterator to initialize.
+ */
+void
+hash_iter_init(hash_t *hashtable, hash_iter_t *iter);
+
+/**
+ * Move an iterator to the next entry of its hash table.
+ *
+ * @param iter The iterator.
+ * @param key Set to the entry's key, owned by the table. May be NULL.
+ * @param data Set to the entry's data. May be NULL.
+ *
+ * @return True if an entry was found, false once all entries were visited.
+ */
+bool
+hash_iter_next(hash_iter_t *iter, const char **key, void **data);
+
+/**
+ * Delete the entry an iterator is positioned on, freeing its key and data.
+ *
+ * Iteration continues with the following entry. The table only shrinks
+ * once the iteration has run to completion.
+ *
+ * @param iter The iterator.
+ */
+void
+hash_iter_del(hash_iter_t *iter);
+
+#if defined(HASH_FOREACH)
+# undef HASH_FOREACH
+#endif
+
+#define HASH_FOREACH(_hashtable, _iter, _key, _data) \
+        for (hash_iter_init(_hashtable, &_iter); \
+             hash_iter_next(&_iter, &_key, (void **) &_data);)
+
+/**
+ * Write a hash table to a file that hash_mmap_open() can map.
+ *
+ * Every value must be a NULL terminated string or NULL. The file is
+ * written beside path and renamed over it, so processes still mapping an
+ * older copy are unaffected. The layout uses native byte order.
+ *
+ * @param hashtable The hash table to save.
+ * @param path The path of the file to write.
+ *
+ * @return True on success, false on failure.
+ */
+bool
+hash_save(hash_t *hashtable, const char *path);
+
+/**
+ * Map a file written by hash_save() as a read-only hash table.
+ *
+ * Nothing is parsed or rehashed, hash_find() and iteration read the
+ * mapping directly and return keys and values that point into it. Adding
+ * or deleting entries is refused. hash_free() unmaps the file.
+ *
+ * Every key and value is checked once to end inside the file, so a
+ * truncated or damaged file is refused rather than read past its end.
+ *
+ * @param path The path of the file to map.
+ *
+ * @return A pointer to the mapped hash table or NULL on failure or if the file is damaged.
+ */
+hash_t *
+hash_mmap_open(const char *path);
+
+/**
+ * Hash a block of memory with the function used by hash tables.
+ *
+ * @param key The memory to hash.
+ * @param len The length of the memory in bytes.
+ * @param seed The seed to hash with.
+ *
+ * @return A 64-bit hash of the memory.
+ */
+uint64_t
+hash_bytes(const void *key, size_t len, uint64_t seed);
+
 char **
 hash_keys_get(hash_t *hashtable);
 
@@ -0,0 +1,3 @@
+#include "imap.h"
+
+IMAP_FUNCTIONS(, imap, void *)
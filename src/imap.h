@@ -0,0 +1,241 @@
+#ifndef __IMAP_H__
+#define __IMAP_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/types.h>
+
+/**
+ * @file
+ * @brief These routines are for using a map keyed by integers.
+ */
+
+/* Smallest number of slots a map holds, must be a power of two. */
+#define IMAP_SIZE_MIN 16
+
+/**
+ * @brief Integer keyed map.
+ * @defgroup IMap
+ *
+ * @{
+ *
+ * Maps integer keys (file descriptors, watch descriptors, pids...) to
+ * values using open addressing with linear probing.
+ *
+ * Keys are stored inline next to their value and are not hashed: a key is
+ * folded with its own high bits and masked, so a dense range of small keys
+ * lands in consecutive slots without colliding. Deleting shifts the rest of
+ * the probe chain back rather than leaving tombstones.
+ *
+ * IMAP_INLINE(name, type) generates a map type name_t whose values are
+ * stored inline as type, along with static inline functions:
+ *
+ *  - name_t *name_new(void)
+ *  - bool name_add(name_t *map, int64_t key, type value)
+ *  - type *name_find(name_t *map, int64_t key)
+ *  - bool name_del(name_t *map, int64_t key)
+ *  - void name_free(name_t *map)
+ *
+ * name_find() returns a pointer to the value stored in the map, valid until
+ * the next add or delete, or NULL if the key is missing.
+ *
+ * The library provides imap_t, an instance holding void pointers. Values
+ * are never freed by the map.
+ */
+
+#define IMAP_TYPE(_name, _type) \
+   typedef struct _name##_slot_t \
+   { \
+      int64_t key; \
+      _type   value; \
+   } _name##_slot_t; \
+   \
+   typedef struct _name##_t \
+   { \
+      _name##_slot_t *slots; \
+      uint8_t        *used; \
+      size_t          size; \
+      size_t          count; \
+      unsigned int    bits; \
+   } _name##_t;
+
+#define IMAP_PROTOTYPES(_scope, _name, _type) \
+   _scope _name##_t *_name##_new(void); \
+   _scope bool _name##_add(_name##_t *map, int64_t key, _type value); \
+   _scope _type *_name##_find(_name##_t *map, int64_t key); \
+   _scope bool _name##_del(_name##_t *map, int64_t key); \
+   _scope void _name##_free(_name##_t *map);
+
+#define IMAP_FUNCTIONS(_scope, _name, _type) \
+   static inline size_t \
+   _name##_index(const _name##_t *map, int64_t key) \
+   { \
+      uint64_t k = (uint64_t) key; \
+      \
+      return (size_t) (k ^ (k >> map->bits)) & (map->size - 1); \
+   } \
+   \
+   static inline bool \
+   _name##_resize(_name##_t *map, size_t size) \
+   { \
+      _name##_slot_t *slots, *old = map->slots; \
+      uint8_t *used, *old_used = map->used; \
+      size_t i, idx, old_size = map->size; \
+      \
+      slots = malloc(size * sizeof(_name##_slot_t)); \
+      used = calloc(size, sizeof(uint8_t)); \
+      if (!slots || !used) \
+        { \
+           free(slots); \
+           free(used); \
+           return false; \
+        } \
+      \
+      map->slots = slots; \
+      map->used = used; \
+      map->size = size; \
+      for (map->bits = 0; ((size_t) 1 << map->bits) < size; map->bits++); \
+      \
+      for (i = 0; i < old_size; i++) \
+        { \
+           if (!old_used[i]) \
+             continue; \
+           \
+           idx = _name##_index(map, old[i].key); \
+           while (used[idx]) \
+             idx = (idx + 1) & (size - 1); \
+           \
+           used[idx] = 1; \
+           slots[idx] = old[i]; \
+        } \
+      \
+      free(old); \
+      free(old_used); \
+      \
+      return true; \
+   } \
+   \
+   static inline ssize_t \
+   _name##_slot_find(const _name##_t *map, int64_t key) \
+   { \
+      size_t idx = _name##_index(map, key); \
+      \
+      while (map->used[idx]) \
+        { \
+           if (map->slots[idx].key == key) \
+             return idx; \
+           idx = (idx + 1) & (map->size - 1); \
+        } \
+      \
+      return -1; \
+   } \
+   \
+   _scope _name##_t * \
+   _name##_new(void) \
+   { \
+      _name##_t *map = calloc(1, sizeof(_name##_t)); \
+      if (!map) \
+        return NULL; \
+      \
+      if (!_name##_resize(map, IMAP_SIZE_MIN)) \
+        { \
+           free(map); \
+           return NULL; \
+        } \
+      \
+      return map; \
+   } \
+   \
+   _scope bool \
+   _name##_add(_name##_t *map, int64_t key, _type value) \
+   { \
+      ssize_t found = _name##_slot_find(map, key); \
+      size_t idx; \
+      \
+      if (found >= 0) \
+        { \
+           map->slots[found].value = value; \
+           return true; \
+        } \
+      \
+      if ((map->count + 1) * 4 > map->size * 3 && !_name##_resize(map, map->size << 1)) \
+        return false; \
+      \
+      idx = _name##_index(map, key); \
+      while (map->used[idx]) \
+        idx = (idx + 1) & (map->size - 1); \
+      \
+      map->used[idx] = 1; \
+      map->slots[idx].key = key; \
+      map->slots[idx].value = value; \
+      map->count++; \
+      \
+      return true; \
+   } \
+   \
+   _scope _type * \
+   _name##_find(_name##_t *map, int64_t key) \
+   { \
+      ssize_t idx = _name##_slot_find(map, key); \
+      \
+      if (idx < 0) \
+        return NULL; \
+      \
+      return &map->slots[idx].value; \
+   } \
+   \
+   _scope bool \
+   _name##_del(_name##_t *map, int64_t key) \
+   { \
+      size_t i, j, home, mask = map->size - 1; \
+      ssize_t idx = _name##_slot_find(map, key); \
+      \
+      if (idx < 0) \
+        return false; \
+      \
+      /* Pull back later entries of the chain that may live in the gap. */ \
+      for (i = j = idx;;) \
+        { \
+           j = (j + 1) & mask; \
+           if (!map->used[j]) \
+             break; \
+           \
+           home = _name##_index(map, map->slots[j].key); \
+           if ((i <= j) ? (home <= i || home > j) : (home <= i && home > j)) \
+             { \
+                map->slots[i] = map->slots[j]; \
+                i = j; \
+             } \
+        } \
+      \
+      map->used[i] = 0; \
+      map->count--; \
+      \
+      if (map->size > IMAP_SIZE_MIN && map->count * 8 < map->size) \
+        _name##_resize(map, map->size >> 1); \
+      \
+      return true; \
+   } \
+   \
+   _scope void \
+   _name##_free(_name##_t *map) \
+   { \
+      free(map->slots); \
+      free(map->used); \
+      free(map); \
+   }
+
+#define IMAP_INLINE(_name, _type) \
+   IMAP_TYPE(_name, _type) \
+   IMAP_FUNCTIONS(static inline, _name, _type)
+
+IMAP_TYPE(imap, void *)
+
+IMAP_PROTOTYPES(, imap, void *)
+
+/**
+ * @}
+ */
+#endif
@@ -1,4 +1,6 @@
 #include "list.h"
+#include "system.h"
+#include "thread.h"
 #include <stdlib.h>
 
 list_t *
@@ -75,42 +77,152 @@ list_free(list_t *list)
      }
 }
 
-static void
-_list_swap_data(list_t *a, list_t *b)
+/* Merge two sorted lists, taking from a on ties so equal items keep their order. */
+static list_t *
+_list_merge(list_t *a, list_t *b, int (*sort_cmp_fn)(void *, void *))
 {
-   void *data = a->data;
+   list_t head, *tail = &head;
 
-   a->data = b->data;
-   b->data = data;
+   while (a && b)
+     {
+        if (sort_cmp_fn(a->data, b->data) <= 0)
+          {
+             tail->next = a;
+             a = a->next;
+          }
+        else
+          {
+             tail->next = b;
+             b = b->next;
+          }
+        tail = tail->next;
+     }
+
+   tail->next = a ? a : b;
+
+   return head.next;
 }
 
 list_t *
 list_sort(list_t *list, int (*sort_cmp_fn)(void *, void *))
 {
-   list_t *node, *last = NULL;
-   int swapped;
+   list_t *runs[LIST_SORT_RUNS_MAX] = { NULL };
+   list_t *node, *run, *next;
+   int i;
 
-   do
+   /* runs[i] holds a sorted run of 2^i nodes, older than anything in runs[< i]. */
+   for (node = list; node; node = next)
      {
-         swapped = 0;
-         node = list;
+        next = node->next;
+        node->next = NULL;
 
-         while (node->next != last)
-           {
-              int res = sort_cmp_fn(node->data, node->next->data);
-              if (res > 0)
-                {
-                   _list_swap_data(node->next, node);
-                   swapped = 1;
-                }
-              node = node->next;
-           }
+        run = node;
+        for (i = 0; i < LIST_SORT_RUNS_MAX - 1 && runs[i]; i++)
+          {
+             run = _list_merge(runs[i], run, sort_cmp_fn);
+             runs[i] = NULL;
+          }
 
-        last = node;
+        if (runs[i])
+          run = _list_merge(runs[i], run, sort_cmp_fn);
+        runs[i] = run;
      }
-   while (swapped);
 
-   return list;
+   for (run = NULL, i = 0; i < LIST_SORT_RUNS_MAX; i++)
+     {
+        if (runs[i])
+          run = _list_merge(runs[i], run, sort_cmp_fn);
+     }
+
+   return run;
+}
+
+typedef struct _list_sort_job_t
+{
+   list_t *list;
+   int   (*sort_cmp_fn)(void *, void *);
+} _list_sort_job_t;
+
+static void *
+_list_sort_job_run(thread_t *thread, void *data)
+{
+   _list_sort_job_t *job = data;
+
+   (void) thread;
+
+   job->list = list_sort(job->list, job->sort_cmp_fn);
+
+   return NULL;
+}
+
+list_t *
+list_sort_parallel(list_t *list, int (*sort_cmp_fn)(void *, void *), unsigned int workers)
+{
+   list_t *node;
+   size_t i, j, count, chunk;
+
+   if (!workers)
+     workers = system_cpu_count();
+
+   count = 0;
+   for (node = list; node; node = node->next)
+     count++;
+
+   if (workers > count / LIST_SORT_PARALLEL_MIN)
+     workers = count / LIST_SORT_PARALLEL_MIN;
+
+   if (workers < 2)
+     return list_sort(list, sort_cmp_fn);
+
+   _list_sort_job_t jobs[workers];
+   thread_t *threads[workers];
+
+   /* Cut the list into consecutive chunks, one per worker. */
+   chunk = (count + workers - 1) / workers;
+   node = list;
+   for (i = 0; i < workers; i++)
+     {
+        jobs[i].list = node;
+        jobs[i].sort_cmp_fn = sort_cmp_fn;
+
+        for (j = 1; node && j < chunk; j++)
+          node = node->next;
+
+        if (node)
+          {
+             list_t *next = node->next;
+             node->next = NULL;
+             node = next;
+          }
+     }
+
+   /* The calling thread sorts the first chunk, and any a thread couldn't start for. */
+   for (i = 1; i < workers; i++)
+     {
+        threads[i] = thread_run(_list_sort_job_run, NULL, NULL, &jobs[i]);
+        if (!threads[i])
+          _list_sort_job_run(NULL, &jobs[i]);
+     }
+
+   _list_sort_job_run(NULL, &jobs[0]);
+
+   for (i = 1; i < workers; i++)
+     {
+        if (threads[i])
+          {
+             thread_wait(threads[i]);
+             free(threads[i]);
+          }
+     }
+
+   /* Merge neighbouring chunks pairwise so earlier chunks stay on the left. */
+   for (chunk = 1; chunk < workers; chunk <<= 1)
+     {
+        for (i = 0; i + chunk < workers; i += chunk << 1)
+          jobs[i].list = _list_merge(jobs[i].list, jobs[i + chunk].list, sort_cmp_fn);
+     }
+
+   return jobs[0].list;
 }
 
 void *
@@ -186,3 +298,111 @@ list_reverse(list_t *list)
    return prev;
 }
 
+
+void
+list_head_init(list_head_t *head)
+{
+   head->first = head->last = NULL;
+   head->count = 0;
+   head->pool = NULL;
+}
+
+void
+list_head_init_pool(list_head_t *head, pool_t *pool)
+{
+   list_head_init(head);
+   head->pool = pool;
+}
+
+static list_t *
+_list_head_node_new(list_head_t *head)
+{
+   if (head->pool)
+     return pool_alloc(head->pool);
+
+   return malloc(sizeof(list_t));
+}
+
+bool
+list_head_append(list_head_t *head, void *data)
+{
+   list_t *node = _list_head_node_new(head);
+   if (!node)
+     return false;
+
+   node->data = data;
+   node->next = NULL;
+
+   if (head->last)
+     head->last->next = node;
+   else
+     head->first = node;
+
+   head->last = node;
+   head->count++;
+
+   return true;
+}
+
+bool
+list_head_prepend(list_head_t *head, void *data)
+{
+   list_t *node = _list_head_node_new(head);
+   if (!node)
+     return false;
+
+   node->data = data;
+   node->next = head->first;
+
+   head->first = node;
+   if (!head->last)
+     head->last = node;
+   head->count++;
+
+   return true;
+}
+
+size_t
+list_head_count(list_head_t *head)
+{
+   return head->count;
+}
+
+void *
+list_head_last(list_head_t *head)
+{
+   if (!head->last)
+     return NULL;
+
+   return head->last->data;
+}
+
+list_t *
+list_head_steal(list_head_t *head)
+{
+   list_t *list = head->first;
+
+   head->first = head->last = NULL;
+   head->count = 0;
+
+   return list;
+}
+
+void
+list_head_free(list_head_t *head)
+{
+   list_t *next, *node;
+
+   if (!head->pool)
+     {
+        list_free(list_head_steal(head));
+        return;
+     }
+
+   for (node = list_head_steal(head); node; node = next)
+     {
+        next = node->next;
+        free(node->data);
+        pool_release(head->pool, node);
+     }
+}
@@ -1,11 +1,21 @@
 #ifndef __LIST_H__
 #define __LIST_H__
 
+#include "pool.h"
+#include <stdbool.h>
+#include <stddef.h>
+
 /**
  * @file
  * @brief These routines are for manipulating and using a linked list.
  */
 
+/* Sorted runs list_sort() keeps, enough for 2^64 nodes. */
+#define LIST_SORT_RUNS_MAX 64
+
+/* Fewest nodes list_sort_parallel() hands to each worker thread. */
+#define LIST_SORT_PARALLEL_MIN 16384
+
 /**
  * @brief Linked list creation and manipulation.
  * @defgroup List
@@ -13,6 +23,16 @@
  * @{
  *
  * Creation and manipulation of a linked list.
+ *
+ * A bare list_t is its own first node, so list_add() and list_count() walk
+ * the whole list. When building a long list keep a list_head_t alongside
+ * it instead, which tracks the last node and the length so appending,
+ * prepending and counting take constant time. The nodes it holds are an
+ * ordinary list_t and its first member can be handed to any list_ function.
+ *
+ * A list head initialized with list_head_init_pool() takes its nodes from
+ * a pool_t rather than malloc(). Its nodes must then only be freed through
+ * list_head_free() or by freeing the pool.
  */
 typedef struct list_t list_t;
 struct list_t
@@ -21,6 +41,14 @@ struct list_t
    list_t *next;
 };
 
+typedef struct list_head_t
+{
+   list_t *first;
+   list_t *last;
+   size_t  count;
+   pool_t *pool;
+} list_head_t;
+
 /**
  * Initialize a new list.
  *
@@ -53,6 +81,10 @@ list_t
 /**
  * Sort a list.
  *
+ * This is a stable bottom-up merge sort taking O(n log n) comparisons. The
+ * nodes are relinked in place and nothing is allocated, so the head of the
+ * list may change and the returned list must be used in its place.
+ *
  * @param list The list to sort.
  * @param sort_cmp_fn The function pointer used to compare and sort the list.
  *
@@ -61,6 +93,24 @@ list_t
 list_t *
 list_sort(list_t *list, int (*sort_cmp_fn)(void *, void *));
 
+/**
+ * Sort a list using several threads.
+ *
+ * The list is cut into consecutive chunks of at least LIST_SORT_PARALLEL_MIN
+ * nodes, each sorted with list_sort() on its own thread, and the sorted
+ * chunks are merged. The result is the same as list_sort(), shorter lists
+ * are simply sorted on the calling thread. sort_cmp_fn must be safe to call
+ * from several threads at once.
+ *
+ * @param list The list to sort.
+ * @param sort_cmp_fn The function pointer used to compare and sort the list.
+ * @param workers The most threads to use, including the caller. Zero uses one per CPU.
+ *
+ * @return The sorted list.
+ */
+list_t *
+list_sort_parallel(list_t *list, int (*sort_cmp_fn)(void *, void *), unsigned int workers);
+
 /**
  * Reverse a list.
  *
@@ -122,6 +172,83 @@ list_count(list_t *list);
 void
 list_free(list_t *list);
 
+/**
+ * Initialize an empty list head.
+ *
+ * @param head The list head to initialize.
+ */
+void
+list_head_init(list_head_t *head);
+
+/**
+ * Initialize an empty list head whose nodes come from a pool.
+ *
+ * @param head The list head to initialize.
+ * @param pool A pool of objects at least sizeof(list_t) bytes, shared by any number of lists.
+ */
+void
+list_head_init_pool(list_head_t *head, pool_t *pool);
+
+/**
+ * Append an item to the end of a list head in constant time.
+ *
+ * @param head The list head to add to.
+ * @param data The data to be appended.
+ *
+ * @return True on success, false if memory could not be allocated.
+ */
+bool
+list_head_append(list_head_t *head, void *data);
+
+/**
+ * Prepend an item to the start of a list head in constant time.
+ *
+ * @param head The list head to add to.
+ * @param data The data to be prepended.
+ *
+ * @return True on success, false if memory could not be allocated.
+ */
+bool
+list_head_prepend(list_head_t *head, void *data);
+
+/**
+ * Return the number of items held by a list head.
+ *
+ * @param head The list head to query.
+ *
+ * @return The number of items.
+ */
+size_t
+list_head_count(list_head_t *head);
+
+/**
+ * Return the last item held by a list head.
+ *
+ * @param head The list head to query.
+ *
+ * @return The data of the last item or NULL if empty.
+ */
+void *
+list_head_last(list_head_t *head);
+
+/**
+ * Take the nodes out of a list head, leaving it empty.
+ *
+ * @param head The list head to empty.
+ *
+ * @return The list that was held, to be freed with list_free() unless its nodes came from a pool.
+ */
+list_t *
+list_head_steal(list_head_t *head);
+
+/**
+ * Free all nodes and their data held by a list head, leaving it empty.
+ *
+ * @param head The list head to empty.
+ */
+void
+list_head_free(list_head_t *head);
+
 #if defined(LIST_FOREACH)
 # undef LIST_FOREACH
 #endif
@@ -130,6 +257,13 @@ list_free(list_t *list);
         if (_list) \
           for (_l = _list; _l && (_data = _l->data); _l = _l->next)
 
+#if defined(LIST_HEAD_FOREACH)
+# undef LIST_HEAD_FOREACH
+#endif
+
+#define LIST_HEAD_FOREACH(_head, _l, _data) \
+        LIST_FOREACH((_head)->first, _l, _data)
+
 /**
  * @}
  */
@@ -48,13 +48,13 @@ static int
 _path_scan_cb(const char *path, stat_t *st, void *data)
 {
    file_info_t *entry;
-   list_t *l = data;
+   list_head_t *files = data;
 
    entry = malloc(sizeof(file_info_t));
    entry->path = strdup(path);
    entry->st = *st;
 
-   l = list_add(l, entry);
+   list_head_append(files, entry);
 
    return 0;
 }
@@ -62,6 +62,7 @@ _path_scan_cb(const char *path, stat_t *st, void *data)
 static void
 _notify_engine_fallback(notify_t *notify)
 {
+   list_head_t scan;
    list_t *next_list;
    list_t *l, *l2;
    file_info_t *file, *file2;
@@ -73,10 +74,12 @@ _notify_engine_fallback(notify_t *notify)
    file->st = *tmp;
    free(tmp);
 
-   next_list = list_new();
-   next_list = list_add(next_list, file);
+   list_head_init(&scan);
+   list_head_append(&scan, file);
 
-   file_path_walk(notify->path, _path_scan_cb, next_list);
+   file_path_walk(notify->path, _path_scan_cb, &scan);
+
+   next_list = list_head_steal(&scan);
 
    l = notify->prev_list;
    while (l)
@@ -187,6 +190,7 @@ _notify_path_add(notify_t *notify, const char *path)
           {
              dir->wd = inotify_add_watch(notify->fd, path, IN_CREATE | IN_DELETE | IN_MODIFY | IN_MOVE);
              dir->path = strdup(path);
+             imap_add(notify->dirs_by_wd, dir->wd, dir);
              return;
           }
      }
@@ -198,6 +202,7 @@ _notify_path_add(notify_t *notify, const char *path)
    notify->dirs[notify->dirs_count] = malloc(sizeof(notify_watch_t));
    notify->dirs[notify->dirs_count]->path = strdup(path);
    notify->dirs[notify->dirs_count]->wd = inotify_add_watch(notify->fd, path, IN_CREATE | IN_DELETE | IN_MODIFY);
+   imap_add(notify->dirs_by_wd, notify->dirs[notify->dirs_count]->wd, notify->dirs[notify->dirs_count]);
    notify->dirs_count++;
 }
 
@@ -212,14 +217,14 @@ _list_cmp(void *p1, void *p2)
 static int
 _notify_add_walk_cb(const char *path, stat_t *st, void *data)
 {
-   list_t *files;
+   list_head_t *files;
 
    if (!S_ISDIR(st->mode))
      return 0;
 
    files = data;
 
-   files = list_add(files, strdup(path));
+   list_head_append(files, strdup(path));
 
    return 0;
 }
@@ -227,11 +232,13 @@ _notify_add_walk_cb(const char *path, stat_t *st, void *data)
 static void
 _notify_path_recursive_add(notify_t *notify, const char *path)
 {
-   list_t *l, *files = list_new();
+   list_head_t dirs;
+   list_t *l, *files;
 
-   files = list_add(files, strdup(path));
-   file_path_walk(path, _notify_add_walk_cb, files);
-   files = list_sort(files, _list_cmp);
+   list_head_init(&dirs);
+   list_head_append(&dirs, strdup(path));
+   file_path_walk(path, _notify_add_walk_cb, &dirs);
+   files = list_sort(list_head_steal(&dirs), _list_cmp);
 
    l = files;
    while (l)
@@ -260,6 +267,7 @@ _notify_path_remove(notify_t *notify, const char *path)
         if (dir->path && !strcmp(path, dir->path))
           {
              inotify_rm_watch(notify->fd, dir->wd);
+             imap_del(notify->dirs_by_wd, dir->wd);
              dir->wd = -1;
              free(dir->path);
              dir->path = NULL;
@@ -324,13 +332,14 @@ _notify_event_handler(notify_t *notify, const char *path, struct inotify_event *
 static char *
 _notify_path_by_wd(notify_t *notify, int wd)
 {
-   for (int i = 0; i < notify->dirs_count; i++)
-     {
-        if (notify->dirs[i]->wd == wd)
-          return notify->dirs[i]->path;
-     }
+   notify_watch_t *dir;
+   void **found = imap_find(notify->dirs_by_wd, wd);
+   if (!found)
+     return NULL;
+
+   dir = *found;
 
-   return NULL;
+   return dir->path;
 }
 
 static int
@@ -370,6 +379,8 @@ _notify_watch(notify_t *notify)
 
    notify->fd = fd;
 
+   notify->dirs_by_wd = imap_new();
+
    _notify_path_add(notify, notify->path);
 
    file_path_walk(notify->path, _notify_watch_walk_cb, notify);
@@ -378,6 +389,7 @@ _notify_watch(notify_t *notify)
      {
         notify_watch_t *dirs = notify->dirs[i];
         dirs->wd = inotify_add_watch(fd, dirs->path, IN_CREATE | IN_DELETE | IN_MODIFY | IN_MOVE);
+        imap_add(notify->dirs_by_wd, dirs->wd, dirs);
      }
 
    notify->ready = true;
@@ -425,6 +437,7 @@ _notify_watch(notify_t *notify)
      }
 
    free(notify->dirs);
+   imap_free(notify->dirs_by_wd);
 
    close(fd);
 #elif defined(__MacOS__) || defined(__FreeBSD__) || defined(__DragonFly__) || defined(__OpenBSD__) || defined(__NetBSD__)
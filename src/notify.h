@@ -8,6 +8,7 @@
 
 #include "list.h"
 #include "file.h"
+#include "imap.h"
 #include <pthread.h>
 #include <unistd.h>
 
@@ -57,6 +58,7 @@ typedef struct notify_t
    int                 fd;
    notify_watch_t     **dirs;
    int                 dirs_count;
+   imap_t             *dirs_by_wd;
 
    void                *file_added_data;
    void                *file_deleted_data;
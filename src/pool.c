@@ -0,0 +1,275 @@
+#include "pool.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct _pool_cache_t
+{
+   void         *free;
+   unsigned int  count;
+   pool_t       *pool;
+   pool_cache_t *next;
+};
+
+/* Slabs are chained through their first word, objects start after it. */
+#define POOL_SLAB_HEADER POOL_ALIGN
+
+#define POOL_NEXT(_obj) (*(void **) (_obj))
+
+static bool
+_pool_slab_add(pool_t *pool)
+{
+   char *slab = aligned_alloc(POOL_ALIGN, pool->slab_size);
+   if (!slab)
+     return false;
+
+   POOL_NEXT(slab) = pool->slabs;
+   pool->slabs = slab;
+
+   pool->bump = slab + POOL_SLAB_HEADER;
+   pool->end = slab + pool->slab_size;
+
+   return true;
+}
+
+/* Take an object from the shared free list or a slab, holding the lock. */
+static void *
+_pool_take(pool_t *pool)
+{
+   void *obj = pool->free;
+
+   if (obj)
+     {
+        pool->free = POOL_NEXT(obj);
+        return obj;
+     }
+
+   if ((size_t) (pool->end - pool->bump) < pool->size && !_pool_slab_add(pool))
+     return NULL;
+
+   obj = pool->bump;
+   pool->bump += pool->size;
+
+   return obj;
+}
+
+/* Return count objects from the head of a cache to the shared free list. */
+static void
+_pool_cache_drain(pool_t *pool, pool_cache_t *cache, unsigned int count)
+{
+   void *first, *last;
+
+   if (!count)
+     return;
+
+   first = last = cache->free;
+   for (unsigned int i = 1; i < count; i++)
+     last = POOL_NEXT(last);
+
+   cache->free = POOL_NEXT(last);
+   cache->count -= count;
+
+   spinlock_take(&pool->lock);
+   POOL_NEXT(last) = pool->free;
+   pool->free = first;
+   spinlock_release(&pool->lock);
+}
+
+static void
+_pool_cache_refill(pool_t *pool, pool_cache_t *cache)
+{
+   void *obj;
+
+   spinlock_take(&pool->lock);
+
+   for (int i = 0; i < POOL_CACHE_BATCH; i++)
+     {
+        obj = _pool_take(pool);
+        if (!obj)
+          break;
+
+        POOL_NEXT(obj) = cache->free;
+        cache->free = obj;
+        cache->count++;
+     }
+
+   spinlock_release(&pool->lock);
+}
+
+/* Runs as a thread exits, handing its cached objects back to the pool. */
+static void
+_pool_cache_destroy(void *data)
+{
+   pool_cache_t **link, *cache = data;
+   pool_t *pool = cache->pool;
+
+   _pool_cache_drain(pool, cache, cache->count);
+
+   spinlock_take(&pool->lock);
+   for (link = &pool->caches; *link; link = &(*link)->next)
+     {
+        if (*link == cache)
+          {
+             *link = cache->next;
+             break;
+          }
+     }
+   spinlock_release(&pool->lock);
+
+   free(cache);
+}
+
+static pool_cache_t *
+_pool_cache_get(pool_t *pool)
+{
+   pool_cache_t *cache;
+
+   if (!pool->keyed)
+     return NULL;
+
+   cache = pthread_getspecific(pool->key);
+   if (cache)
+     return cache;
+
+   cache = calloc(1, sizeof(pool_cache_t));
+   if (!cache)
+     return NULL;
+
+   cache->pool = pool;
+
+   if (pthread_setspecific(pool->key, cache))
+     {
+        free(cache);
+        return NULL;
+     }
+
+   spinlock_take(&pool->lock);
+   cache->next = pool->caches;
+   pool->caches = cache;
+   spinlock_release(&pool->lock);
+
+   return cache;
+}
+
+pool_t *
+pool_new(size_t size)
+{
+   pool_t *pool;
+
+   if (!size || size > (SIZE_MAX - POOL_SLAB_HEADER) / POOL_SLAB_OBJECTS_MIN)
+     return NULL;
+
+   pool = calloc(1, sizeof(pool_t));
+   if (!pool)
+     return NULL;
+
+   /* Every object must hold a free list link and keep the next one aligned. */
+   if (size < sizeof(void *))
+     size = sizeof(void *);
+   pool->size = (size + POOL_ALIGN - 1) & ~((size_t) POOL_ALIGN - 1);
+
+   pool->slab_size = POOL_SLAB_HEADER + pool->size * POOL_SLAB_OBJECTS_MIN;
+   if (pool->slab_size < POOL_SLAB_SIZE)
+     pool->slab_size = POOL_SLAB_SIZE;
+
+   spinlock_init(&pool->lock);
+
+   pool->keyed = !pthread_key_create(&pool->key, _pool_cache_destroy);
+
+   return pool;
+}
+
+void *
+pool_alloc(pool_t *pool)
+{
+   pool_cache_t *cache = _pool_cache_get(pool);
+   void *obj;
+
+   if (!cache)
+     {
+        spinlock_take(&pool->lock);
+        obj = _pool_take(pool);
+        spinlock_release(&pool->lock);
+
+        return obj;
+     }
+
+   if (!cache->free)
+     _pool_cache_refill(pool, cache);
+
+   obj = cache->free;
+   if (obj)
+     {
+        cache->free = POOL_NEXT(obj);
+        cache->count--;
+     }
+
+   return obj;
+}
+
+void *
+pool_calloc(pool_t *pool)
+{
+   void *obj = pool_alloc(pool);
+
+   if (obj)
+     memset(obj, 0, pool->size);
+
+   return obj;
+}
+
+void
+pool_release(pool_t *pool, void *ptr)
+{
+   pool_cache_t *cache;
+
+   if (!ptr)
+     return;
+
+   cache = _pool_cache_get(pool);
+   if (!cache)
+     {
+        spinlock_take(&pool->lock);
+        POOL_NEXT(ptr) = pool->free;
+        pool->free = ptr;
+        spinlock_release(&pool->lock);
+
+        return;
+     }
+
+   POOL_NEXT(ptr) = cache->free;
+   cache->free = ptr;
+   cache->count++;
+
+   if (cache->count >= POOL_CACHE_BATCH * 2)
+     _pool_cache_drain(pool, cache, POOL_CACHE_BATCH);
+}
+
+void
+pool_free(pool_t *pool)
+{
+   pool_cache_t *cache, *next_cache;
+   void *slab, *next;
+
+   if (!pool)
+     return;
+
+   if (pool->keyed)
+     pthread_key_delete(pool->key);
+
+   for (cache = pool->caches; cache; cache = next_cache)
+     {
+        next_cache = cache->next;
+        free(cache);
+     }
+
+   for (slab = pool->slabs; slab; slab = next)
+     {
+        next = POOL_NEXT(slab);
+        free(slab);
+     }
+
+   spinlock_destroy(&pool->lock);
+
+   free(pool);
+}
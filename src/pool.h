@@ -0,0 +1,113 @@
+#ifndef __POOL_H__
+#define __POOL_H__
+
+#include "thread.h"
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * @file
+ * @brief These routines are for allocating fixed size objects from a pool.
+ */
+
+/* Bytes carved into objects at a time, a slab holds at least POOL_SLAB_OBJECTS_MIN. */
+#define POOL_SLAB_SIZE (64 * 1024)
+#define POOL_SLAB_OBJECTS_MIN 16
+
+/* Objects a thread's cache moves to or from the shared free list at once. */
+#define POOL_CACHE_BATCH 32
+
+/* Alignment of every object handed out by a pool. */
+#define POOL_ALIGN 16
+
+/**
+ * @brief Fixed size object pool.
+ * @defgroup Pool
+ *
+ * @{
+ *
+ * Hands out objects of one size carved from large slabs, so allocating is
+ * a pointer pop and objects made together sit next to each other in
+ * memory. Released objects go back on a free list for reuse, the slabs
+ * themselves are only returned to the system all at once by pool_free().
+ *
+ * Each thread using a pool keeps a small cache of free objects and only
+ * takes the pool's lock to move POOL_CACHE_BATCH of them between its cache
+ * and the shared free list, so threads rarely contend. A pool is meant to
+ * be long lived and shared by many containers, every pool uses a thread
+ * specific data key and once the system runs out of those a new pool falls
+ * back to taking its lock on every call.
+ *
+ * Objects may be released by a different thread than allocated them. No
+ * thread may use a pool while pool_free() runs.
+ *
+ */
+typedef struct _pool_cache_t pool_cache_t;
+
+typedef struct _pool_t
+{
+   spinlock_t     lock;
+   size_t         size;
+   size_t         slab_size;
+   void          *slabs;
+   void          *free;
+   char          *bump;
+   char          *end;
+   pool_cache_t  *caches;
+   pthread_key_t  key;
+   bool           keyed;
+} pool_t;
+
+/**
+ * Create a new pool of objects.
+ *
+ * @param size The size in bytes of every object.
+ *
+ * @return A pointer to the newly created pool or NULL on failure.
+ */
+pool_t *
+pool_new(size_t size);
+
+/**
+ * Allocate an object from a pool.
+ *
+ * The object's contents are undefined.
+ *
+ * @param pool The pool to allocate from.
+ *
+ * @return A pointer to the object or NULL if memory could not be allocated.
+ */
+void *
+pool_alloc(pool_t *pool);
+
+/**
+ * Allocate a zeroed object from a pool.
+ *
+ * @param pool The pool to allocate from.
+ *
+ * @return A pointer to the object or NULL if memory could not be allocated.
+ */
+void *
+pool_calloc(pool_t *pool);
+
+/**
+ * Give an object back to the pool it was allocated from.
+ *
+ * @param pool The pool the object came from.
+ * @param ptr The object, may be NULL.
+ */
+void
+pool_release(pool_t *pool, void *ptr);
+
+/**
+ * Free a pool along with every object allocated from it.
+ *
+ * @param pool The pool to free.
+ */
+void
+pool_free(pool_t *pool);
+
+/**
+ * @}
+ */
+#endif
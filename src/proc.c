@@ -134,11 +134,12 @@ _parse_line(const char *line)
    return atol(tok);
 }
 
-static list_t *
-_process_list_linux_get(void)
+static array_t *
+_process_array_linux_get(void)
 {
-   char *name;
-   list_t *files, *l, *list = NULL;
+   char **name;
+   array_t *files, *procs;
+   size_t i;
    FILE *f;
 
    char path[PATH_MAX], line[4096], program_name[1024], state;
@@ -147,10 +148,19 @@ _process_list_linux_get(void)
 
    int pagesize = getpagesize();
 
-   files = file_ls("/proc");
-   LIST_FOREACH(files, l, name)
+   procs = array_new(sizeof(proc_t));
+   if (!procs) return NULL;
+
+   files = file_ls_array("/proc");
+   if (!files)
      {
-        pid = atoi(name);
+        array_free(procs);
+        return NULL;
+     }
+
+   ARRAY_FOREACH(files, i, name)
+     {
+        pid = atoi(*name);
         if (!pid) continue;
 
         snprintf(path, sizeof(path), "/proc/%d/stat", pid);
@@ -192,7 +202,8 @@ _process_list_linux_get(void)
 
         fclose(f);
 
-        proc_t *p = calloc(1, sizeof(proc_t));
+        proc_t *p = array_push(procs);
+        if (!p) break;
 
         p->pid = pid;
         p->uid = uid;
@@ -205,14 +216,11 @@ _process_list_linux_get(void)
         p->nice = nice;
         p->priority = pri;
         p->numthreads = numthreads;
-
-        list = list_add(list, p);
      }
 
-   if (files)
-     list_free(files);
+   file_ls_array_free(files);
 
-   return list;
+   return procs;
 }
 
 proc_t *
@@ -326,27 +334,40 @@ proc_info_by_pid(int pid)
    return p;
 }
 
-static list_t *
-_process_list_openbsd_get(void)
+static array_t *
+_process_array_openbsd_get(void)
 {
    struct kinfo_proc *kp;
    proc_t *p;
    char errbuf[4096];
    kvm_t *kern;
    int pid_count, pagesize;
-   list_t *l, *list = list_new();
+   array_t *procs;
+   size_t j;
 
    kern = kvm_openfiles(NULL, NULL, NULL, KVM_NO_FILES, errbuf);
    if (!kern) return NULL;
 
    kp = kvm_getprocs(kern, KERN_PROC_ALL, 0, sizeof(*kp), &pid_count);
-   if (!kp) return NULL;
+   if (!kp)
+     {
+        kvm_close(kern);
+        return NULL;
+     }
+
+   procs = array_new(sizeof(proc_t));
+   if (!procs || !array_reserve(procs, pid_count))
+     {
+        array_free(procs);
+        kvm_close(kern);
+        return NULL;
+     }
 
    pagesize = getpagesize();
 
    for (int i = 0; i < pid_count; i++)
      {
-        p = malloc(sizeof(proc_t));
+        p = array_push(procs);
         p->pid = kp[i].p_pid;
         p->uid = kp[i].p_uid;
         p->cpu_id = kp[i].p_cpuid;
@@ -358,12 +379,11 @@ _process_list_openbsd_get(void)
 	p->priority = kp[i].p_priority - PZERO;
 	p->nice = kp[i].p_nice - NZERO;
         p->numthreads = -1;
-        list = list_add(list, p);
      }
 
    kp = kvm_getprocs(kern, KERN_PROC_SHOW_THREADS, 0, sizeof(*kp), &pid_count);
 
-   LIST_FOREACH(list, l, p)
+   ARRAY_FOREACH(procs, j, p)
      {
         for (int i = 0; i < pid_count; i++)
           {
@@ -374,16 +394,17 @@ _process_list_openbsd_get(void)
 
    kvm_close(kern);
 
-   return list;
+   return procs;
 }
 
 #endif
 
 #if defined(__MacOS__)
-static list_t *
-_process_list_macos_get(void)
+static array_t *
+_process_array_macos_get(void)
 {
-   list_t *list = NULL;
+   array_t *procs = array_new(sizeof(proc_t));
+   if (!procs) return NULL;
 
    for (int i = 1; i <= PID_MAX; i++)
      {
@@ -391,7 +412,9 @@ _process_list_macos_get(void)
         int size = proc_pidinfo(i, PROC_PIDTASKALLINFO, 0, &taskinfo, sizeof(taskinfo));
         if (size != sizeof(taskinfo)) continue;
 
-        proc_t *p = calloc(1, sizeof(proc_t));
+        proc_t *p = array_push(procs);
+        if (!p) break;
+
         p->pid = i;
         p->uid = taskinfo.pbsd.pbi_uid;
         p->cpu_id = -1;
@@ -404,11 +427,9 @@ _process_list_macos_get(void)
         p->priority = taskinfo.ptinfo.pti_priority;
         p->nice = taskinfo.pbsd.pbi_nice;
         p->numthreads = taskinfo.ptinfo.pti_threadnum;
-
-        list = list_add(list, p);
      }
 
-   return list;
+   return procs;
 }
 
 proc_t *
@@ -444,22 +465,23 @@ proc_info_by_pid(int pid)
 #endif
 
 #if defined(__FreeBSD__) || defined(__DragonFly__)
-static list_t *
-_process_list_freebsd_get(void)
+static array_t *
+_process_array_freebsd_get(void)
 {
-   list_t *list;
+   array_t *procs;
    struct rusage *usage;
    struct kinfo_proc kp;
    int mib[4];
    size_t len;
    int pagesize = getpagesize();
 
-   list = list_new();
-
    len = sizeof(int);
    if (sysctlnametomib("kern.proc.pid", mib, &len) == -1)
      return NULL;
 
+   procs = array_new(sizeof(proc_t));
+   if (!procs) return NULL;
+
    for (int i = 1; i <= PID_MAX; i++)
      {
         mib[3] = i;
@@ -469,7 +491,8 @@ _process_list_freebsd_get(void)
              continue;
           }
 
-        proc_t *p = calloc(1, sizeof(proc_t));
+        proc_t *p = array_push(procs);
+        if (!p) break;
 
         p->pid = kp.ki_pid;
         p->uid = kp.ki_uid;
@@ -487,11 +510,9 @@ _process_list_freebsd_get(void)
         p->nice =  kp.ki_nice - NZERO;
         p->priority = kp.ki_pri.pri_level - PZERO;
         p->numthreads = kp.ki_numthreads;
-
-        list = list_add(list, p);
      }
 
-   return list;
+   return procs;
 }
 
 proc_t *
@@ -536,19 +557,19 @@ proc_info_by_pid(int pid)
 
 #endif
 
-list_t *
-proc_info_all_get(void)
+array_t *
+proc_info_all_array_get(void)
 {
-   list_t *processes;
+   array_t *processes;
 
 #if defined(__linux__)
-   processes = _process_list_linux_get();
+   processes = _process_array_linux_get();
 #elif defined(__FreeBSD__) || defined(__DragonFly__)
-   processes = _process_list_freebsd_get();
+   processes = _process_array_freebsd_get();
 #elif defined(__MacOS__)
-   processes = _process_list_macos_get();
+   processes = _process_array_macos_get();
 #elif defined(__OpenBSD__)
-   processes = _process_list_openbsd_get();
+   processes = _process_array_openbsd_get();
 #else
    processes = NULL;
 #endif
@@ -556,3 +577,32 @@ proc_info_all_get(void)
    return processes;
 }
 
+list_t *
+proc_info_all_get(void)
+{
+   array_t *processes;
+   list_head_t list;
+   proc_t *proc, *p;
+   size_t i;
+
+   processes = proc_info_all_array_get();
+   if (!processes) return NULL;
+
+   list_head_init(&list);
+
+   ARRAY_FOREACH(processes, i, proc)
+     {
+        p = malloc(sizeof(proc_t));
+        if (!p || !list_head_append(&list, p))
+          {
+             free(p);
+             break;
+          }
+        *p = *proc;
+     }
+
+   array_free(processes);
+
+   return list_head_steal(&list);
+}
+
@@ -16,6 +16,7 @@
  *
  */
 
+#include "array.h"
 #include "list.h"
 #include <stdint.h>
 #include <unistd.h>
@@ -45,6 +46,17 @@ typedef struct proc_t
 list_t *
 proc_info_all_get(void);
 
+/**
+ * Query all running processes and return them in an array.
+ *
+ * The proc_t entries are stored inline, so the whole result is released
+ * with a single array_free().
+ *
+ * @return An array of proc_t for all processes or NULL on failure.
+ */
+array_t *
+proc_info_all_array_get(void);
+
 /**
  * Query a process for its current state.
  *
@@ -0,0 +1,313 @@
+#if defined(__linux__)
+# define _GNU_SOURCE
+#endif
+#include "ring.h"
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+
+/* Map the same size bytes twice in a row, returns NULL where that isn't possible. */
+static char *
+_mirror_map(size_t size)
+{
+#if defined(__linux__) && defined(MFD_CLOEXEC)
+   char *base, *map;
+   int fd;
+
+   fd = memfd_create("ring", MFD_CLOEXEC);
+   if (fd == -1)
+     return NULL;
+
+   if (ftruncate(fd, size) == -1)
+     goto error;
+
+   base = mmap(NULL, size << 1, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+   if (base == MAP_FAILED)
+     goto error;
+
+   map = mmap(base, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0);
+   if (map == MAP_FAILED)
+     goto unmap;
+
+   map = mmap(base + size, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0);
+   if (map == MAP_FAILED)
+     goto unmap;
+
+   close(fd);
+
+   return base;
+
+unmap:
+   munmap(base, size << 1);
+error:
+   close(fd);
+#else
+   (void) size;
+#endif
+   return NULL;
+}
+
+ring_t *
+ring_new(size_t size, unsigned int flags)
+{
+   ring_t *ring;
+   size_t pow2 = 1;
+   long page;
+
+   if (flags & RING_MIRROR)
+     {
+        page = sysconf(_SC_PAGESIZE);
+        if (page > 0 && size < (size_t) page)
+          size = page;
+     }
+
+   while (pow2 < size)
+     {
+        if (pow2 > SIZE_MAX >> 2)
+          return NULL;
+        pow2 <<= 1;
+     }
+
+   /* The head and tail each start a cache line, calloc() only aligns to 16. */
+   ring = aligned_alloc(_Alignof(ring_t), sizeof(ring_t));
+   if (!ring)
+     return NULL;
+
+   memset(ring, 0, sizeof(ring_t));
+
+   ring->size = pow2;
+   ring->mask = pow2 - 1;
+
+   if (flags & RING_MIRROR)
+     {
+        ring->data = _mirror_map(pow2);
+        ring->mirrored = ring->data != NULL;
+     }
+
+   if (!ring->data)
+     {
+        ring->data = malloc(pow2);
+        if (!ring->data)
+          {
+             free(ring);
+             return NULL;
+          }
+     }
+
+   return ring;
+}
+
+size_t
+ring_count(ring_t *ring)
+{
+   size_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+   size_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+
+   return head - tail;
+}
+
+size_t
+ring_space(ring_t *ring)
+{
+   return ring->size - ring_count(ring);
+}
+
+/* The free region at the head, as up to two runs. Producer side. */
+static int
+_free_iov(ring_t *ring, struct iovec *iov)
+{
+   size_t head = ring->head;
+   size_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+   size_t len = ring->size - (head - tail);
+   size_t off = head & ring->mask;
+   size_t run;
+
+   if (!len)
+     return 0;
+
+   run = ring->mirrored ? len : ring->size - off;
+   if (run >= len)
+     {
+        iov[0].iov_base = ring->data + off;
+        iov[0].iov_len = len;
+        return 1;
+     }
+
+   iov[0].iov_base = ring->data + off;
+   iov[0].iov_len = run;
+   iov[1].iov_base = ring->data;
+   iov[1].iov_len = len - run;
+
+   return 2;
+}
+
+/* The pending region at the tail, as up to two runs. Consumer side. */
+static int
+_used_iov(ring_t *ring, struct iovec *iov)
+{
+   size_t tail = ring->tail;
+   size_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+   size_t len = head - tail;
+   size_t off = tail & ring->mask;
+   size_t run;
+
+   if (!len)
+     return 0;
+
+   run = ring->mirrored ? len : ring->size - off;
+   if (run >= len)
+     {
+        iov[0].iov_base = ring->data + off;
+        iov[0].iov_len = len;
+        return 1;
+     }
+
+   iov[0].iov_base = ring->data + off;
+   iov[0].iov_len = run;
+   iov[1].iov_base = ring->data;
+   iov[1].iov_len = len - run;
+
+   return 2;
+}
+
+size_t
+ring_push(ring_t *ring, const void *data, size_t len)
+{
+   struct iovec iov[2];
+   const char *src = data;
+   size_t done = 0;
+   int count;
+
+   count = _free_iov(ring, iov);
+   for (int i = 0; i < count && done < len; i++)
+     {
+        size_t n = len - done < iov[i].iov_len ? len - done : iov[i].iov_len;
+        memcpy(iov[i].iov_base, src + done, n);
+        done += n;
+     }
+
+   ring_write_commit(ring, done);
+
+   return done;
+}
+
+size_t
+ring_pop(ring_t *ring, void *data, size_t len)
+{
+   struct iovec iov[2];
+   char *dst = data;
+   size_t done = 0;
+   int count;
+
+   count = _used_iov(ring, iov);
+   for (int i = 0; i < count && done < len; i++)
+     {
+        size_t n = len - done < iov[i].iov_len ? len - done : iov[i].iov_len;
+        memcpy(dst + done, iov[i].iov_base, n);
+        done += n;
+     }
+
+   ring_read_commit(ring, done);
+
+   return done;
+}
+
+size_t
+ring_write_ptr(ring_t *ring, void **ptr)
+{
+   struct iovec iov[2];
+
+   if (!_free_iov(ring, iov))
+     return 0;
+
+   *ptr = iov[0].iov_base;
+
+   return iov[0].iov_len;
+}
+
+void
+ring_write_commit(ring_t *ring, size_t len)
+{
+   if (len)
+     __atomic_store_n(&ring->head, ring->head + len, __ATOMIC_RELEASE);
+}
+
+size_t
+ring_read_ptr(ring_t *ring, const void **ptr)
+{
+   struct iovec iov[2];
+
+   if (!_used_iov(ring, iov))
+     return 0;
+
+   *ptr = iov[0].iov_base;
+
+   return iov[0].iov_len;
+}
+
+void
+ring_read_commit(ring_t *ring, size_t len)
+{
+   if (len)
+     __atomic_store_n(&ring->tail, ring->tail + len, __ATOMIC_RELEASE);
+}
+
+ssize_t
+ring_read_fd(ring_t *ring, int fd)
+{
+   struct iovec iov[2];
+   ssize_t bytes;
+   int count;
+
+   count = _free_iov(ring, iov);
+   if (!count)
+     return 0;
+
+   do
+     bytes = count == 1 ? read(fd, iov[0].iov_base, iov[0].iov_len) : readv(fd, iov, count);
+   while (bytes < 0 && errno == EINTR);
+
+   if (bytes > 0)
+     ring_write_commit(ring, bytes);
+
+   return bytes;
+}
+
+ssize_t
+ring_write_fd(ring_t *ring, int fd)
+{
+   struct iovec iov[2];
+   ssize_t bytes;
+   int count;
+
+   count = _used_iov(ring, iov);
+   if (!count)
+     return 0;
+
+   do
+     bytes = count == 1 ? write(fd, iov[0].iov_base, iov[0].iov_len) : writev(fd, iov, count);
+   while (bytes < 0 && errno == EINTR);
+
+   if (bytes > 0)
+     ring_read_commit(ring, bytes);
+
+   return bytes;
+}
+
+void
+ring_free(ring_t *ring)
+{
+   if (!ring)
+     return;
+
+   if (ring->mirrored)
+     munmap(ring->data, ring->size << 1);
+   else
+     free(ring->data);
+
+   free(ring);
+}
@@ -0,0 +1,186 @@
+#ifndef __RING_H__
+#define __RING_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+/**
+ * @file
+ * @brief These routines are for passing bytes between two threads through a ring buffer.
+ */
+
+/* Flags for ring_new(). */
+#define RING_MIRROR (1 << 0)
+
+/**
+ * @brief Single producer, single consumer ring buffer.
+ * @defgroup Ring
+ *
+ * @{
+ *
+ * A fixed size byte queue shared by exactly one writing thread and one
+ * reading thread without locks. The producer only ever advances the head
+ * and the consumer only ever advances the tail, each publishing its
+ * position with a release store, so every push and pop completes in a
+ * bounded number of steps whatever the other thread is doing. The two
+ * positions live on separate cache lines.
+ *
+ * The size is a power of two. A ring created with RING_MIRROR maps the
+ * same memory twice back to back through a memfd, so the free space and
+ * the pending bytes are always one contiguous run even across the wrap
+ * point. Where that isn't available the ring falls back to a single
+ * mapping and runs at the wrap point are split in two.
+ *
+ * ring_read_fd() and ring_write_fd() move data between a descriptor and
+ * the ring directly, without an intermediate buffer.
+ *
+ */
+typedef struct _ring_t
+{
+   char   *data;
+   size_t  size;
+   size_t  mask;
+   bool    mirrored;
+
+   size_t  head __attribute__((aligned(64)));
+   size_t  tail __attribute__((aligned(64)));
+} ring_t;
+
+/**
+ * Create a new ring buffer.
+ *
+ * @param size The capacity in bytes, rounded up to a power of two and with RING_MIRROR to a whole number of pages.
+ * @param flags RING_MIRROR to map the memory twice so no run wraps.
+ *
+ * @return A pointer to the newly created ring or NULL on failure.
+ */
+ring_t *
+ring_new(size_t size, unsigned int flags);
+
+/**
+ * Return the number of bytes waiting to be read.
+ *
+ * Exact when called by the consumer, a lower bound otherwise.
+ *
+ * @param ring The ring to query.
+ *
+ * @return The number of bytes.
+ */
+size_t
+ring_count(ring_t *ring);
+
+/**
+ * Return the number of bytes that can be written.
+ *
+ * Exact when called by the producer, a lower bound otherwise.
+ *
+ * @param ring The ring to query.
+ *
+ * @return The number of bytes.
+ */
+size_t
+ring_space(ring_t *ring);
+
+/**
+ * Copy bytes into a ring, called by the producer.
+ *
+ * @param ring The ring to write to.
+ * @param data The bytes to copy.
+ * @param len The number of bytes.
+ *
+ * @return The number of bytes copied, less than len if the ring filled up.
+ */
+size_t
+ring_push(ring_t *ring, const void *data, size_t len);
+
+/**
+ * Copy bytes out of a ring, called by the consumer.
+ *
+ * @param ring The ring to read from.
+ * @param data Where to copy the bytes to.
+ * @param len The most bytes to copy.
+ *
+ * @return The number of bytes copied, zero if the ring is empty.
+ */
+size_t
+ring_pop(ring_t *ring, void *data, size_t len);
+
+/**
+ * Return the contiguous free space at the head of a ring, called by the producer.
+ *
+ * Fill it in place and publish it with ring_write_commit().
+ *
+ * @param ring The ring to write to.
+ * @param ptr Set to the start of the free space.
+ *
+ * @return The number of bytes available at ptr.
+ */
+size_t
+ring_write_ptr(ring_t *ring, void **ptr);
+
+/**
+ * Publish bytes written in place at the head of a ring.
+ *
+ * @param ring The ring written to.
+ * @param len The number of bytes written, at most what ring_write_ptr() returned.
+ */
+void
+ring_write_commit(ring_t *ring, size_t len);
+
+/**
+ * Return the contiguous pending bytes at the tail of a ring, called by the consumer.
+ *
+ * Release them with ring_read_commit() once done with them.
+ *
+ * @param ring The ring to read from.
+ * @param ptr Set to the start of the pending bytes.
+ *
+ * @return The number of bytes available at ptr.
+ */
+size_t
+ring_read_ptr(ring_t *ring, const void **ptr);
+
+/**
+ * Release bytes at the tail of a ring so the producer can reuse their space.
+ *
+ * @param ring The ring read from.
+ * @param len The number of bytes consumed, at most what ring_read_ptr() returned.
+ */
+void
+ring_read_commit(ring_t *ring, size_t len);
+
+/**
+ * Read from a descriptor straight into a ring, called by the producer.
+ *
+ * @param ring The ring to fill.
+ * @param fd The descriptor to read from.
+ *
+ * @return The number of bytes read, 0 on end of file or if the ring is full, -1 on error with errno set.
+ */
+ssize_t
+ring_read_fd(ring_t *ring, int fd);
+
+/**
+ * Write from a ring straight to a descriptor, called by the consumer.
+ *
+ * @param ring The ring to drain.
+ * @param fd The descriptor to write to.
+ *
+ * @return The number of bytes written, 0 if the ring is empty, -1 on error with errno set.
+ */
+ssize_t
+ring_write_fd(ring_t *ring, int fd);
+
+/**
+ * Free a ring buffer.
+ *
+ * @param ring The ring to free.
+ */
+void
+ring_free(ring_t *ring);
+
+/**
+ * @}
+ */
+#endif
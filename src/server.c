@@ -12,6 +12,7 @@
 #include <netinet/in.h>
 #include <netdb.h>
 #include <poll.h>
+#include "buf.h"
 #include "ipc.h"
 #include "net.h"
 #include "server.h"
@@ -63,7 +64,7 @@ _clients_add(server_t *server, int sock, SSL *ssl)
    sockets[socket_index].fd = sock;
    sockets[socket_index].events = POLLIN;
 
-   tmp = calloc(1, sizeof(server_client_t));
+   tmp = pool_calloc(server->clients_pool);
    if (!tmp)
      return NULL;
 
@@ -73,6 +74,8 @@ _clients_add(server_t *server, int sock, SSL *ssl)
    tmp->is_websocket = server->is_websocket;
    tmp->unixtime = time(NULL);
 
+   imap_add(server->clients_by_fd, sock, tmp);
+
    c = clients[0];
    if (c == NULL)
      {
@@ -130,6 +133,8 @@ _clients_del(server_t *server, server_client_t *client)
 
    client->ssl = NULL;
 
+   imap_del(server->clients_by_fd, client->sock);
+
    close(client->sock);
 
    client->pfd->fd = -1;
@@ -150,7 +155,7 @@ _clients_del(server_t *server, server_client_t *client)
                }
 
              _client_data_free(c);
-             free(c);
+             pool_release(server->clients_pool, c);
              c = NULL;
 
              return;
@@ -161,19 +166,13 @@ _clients_del(server_t *server, server_client_t *client)
 }
 
 static server_client_t *
-_client_by_fd(server_client_t **clients, int fd)
+_client_by_fd(server_t *server, int fd)
 {
-   server_client_t *c = clients[0];
-   while (c)
-     {
-        if (c->sock == fd)
-          {
-             return c;
-          }
-        c = c->next;
-     }
+   void **client = imap_find(server->clients_by_fd, fd);
+   if (!client)
+     return NULL;
 
-   return NULL;
+   return *client;
 }
 
 ssize_t
@@ -185,16 +184,15 @@ server_client_read(server_client_t *client, char *buf, size_t len)
    return read(client->sock, buf, len);
 }
 
+/* Hand received data, allocated with room for a NULL character, to the client. */
 static int
-_client_request(server_client_t *client, char *buf, ssize_t bytes)
+_client_request(server_client_t *client, char *data, ssize_t bytes)
 {
    client->unixtime = time(NULL);
 
    client->received.type = CLIENT_DATA_TYPE_TEXT;
    client->received.size = bytes;
-   client->received.data = malloc(1 + client->received.size * sizeof(char));
-
-   memcpy(client->received.data, buf, client->received.size);
+   client->received.data = data;
    client->received.data[client->received.size] = '\0';
    client->state = CLIENT_STATE_DEFAULT;
 
@@ -204,20 +202,39 @@ _client_request(server_client_t *client, char *buf, ssize_t bytes)
 static int
 _client_read(server_client_t *client)
 {
-   char buf[65535];
+   buf_t buf;
+   char *data;
    ssize_t bytes;
 
    _client_data_free(client);
 
+   buf_init(&buf);
+
+   /* Read straight into a buffer sized from what is pending, a TLS record at most. */
+   if (client->ssl)
+     {
+        bytes = -1;
+        if (buf_reserve(&buf, BUF_READ_SIZE))
+          bytes = server_client_read(client, buf.data, BUF_READ_SIZE);
+        if (bytes > 0)
+          buf.len = bytes;
+     }
+   else
+     {
+        bytes = buf_read_fd(&buf, client->sock, 65534);
+     }
+
    do
      {
-        bytes = server_client_read(client, buf, sizeof(buf) -1);
         if (bytes == 0)
           {
+             buf_clear(&buf);
              return CLIENT_STATE_DISCONNECT;
           }
         else if (bytes < 0)
           {
+             buf_clear(&buf);
+
              if (client->ssl)
                {
                   return CLIENT_STATE_DISCONNECT;
@@ -238,14 +255,17 @@ _client_read(server_client_t *client)
           }
      } while (0);
 
-   buf[bytes] = 0x00;
+   data = buf_detach(&buf);
+   if (!data)
+     return CLIENT_STATE_DISCONNECT;
 
-   return _client_request(client, buf, bytes);
+   return _client_request(client, data, bytes);
 }
 
 static void
-_clients_free(server_client_t **clients)
+_clients_free(server_t *server)
 {
+   server_client_t **clients = server->clients;
    server_client_t *next, *c = clients[0];
 
    while (c)
@@ -257,7 +277,7 @@ _clients_free(server_client_t **clients)
 
         close(c->sock);
 
-        free(c);
+        pool_release(server->clients_pool, c);
         c = next;
      }
 
@@ -387,6 +407,64 @@ server_client_write(server_client_t *client, const char *buf, size_t len)
    return send(client->sock, buf, len, MSG_NOSIGNAL);
 }
 
+int
+server_client_write_chain(server_client_t *client, bufchain_t *chain)
+{
+   const char *data;
+   ssize_t bytes;
+   size_t total = 0;
+
+   /* A websocket message needs its length up front, send it in one frame. */
+   if (client->server->is_websocket)
+     {
+        buf_t message;
+        size_t len = bufchain_len(chain);
+        int ret = -1;
+
+        buf_init(&message);
+
+        if (!buf_reserve(&message, len))
+          return -1;
+
+        /* Consume the chain only once the whole frame has gone out. */
+        if (bufchain_copy(chain, message.data, len) == (ssize_t) len &&
+            ws_client_write(client, message.data, len) == len)
+          {
+             bufchain_consume(chain, len);
+             ret = len;
+          }
+
+        buf_clear(&message);
+
+        return ret;
+     }
+
+   while (bufchain_len(chain))
+     {
+        if (client->ssl)
+          {
+             bytes = bufchain_peek(chain, &data);
+             if (bytes > 0)
+               {
+                  bytes = SSL_write(client->ssl, data, bytes);
+                  if (bytes > 0)
+                    bufchain_consume(chain, bytes);
+               }
+          }
+        else
+          {
+             bytes = bufchain_sendmsg(chain, client->sock, MSG_NOSIGNAL);
+          }
+
+        if (bytes <= 0)
+          return total ? (int) total : -1;
+
+        total += bytes;
+     }
+
+   return total;
+}
+
 char *
 server_client_address_get(server_client_t *client)
 {
@@ -610,7 +688,7 @@ server_event_callback_set(server_t *server, server_callback_t type,
 void
 server_client_del(server_t *server, server_client_t *client)
 {
-   server_client_t *tmp = _client_by_fd(server->clients, client->sock);
+   server_client_t *tmp = _client_by_fd(server, client->sock);
    if (!tmp) return;
 
    _on_del_cb(server, tmp);
@@ -628,7 +706,9 @@ server_free(server_t *server)
           close(sockets[i].fd);
      }
 
-   _clients_free(server->clients);
+   _clients_free(server);
+   imap_free(server->clients_by_fd);
+   pool_free(server->clients_pool);
 
    if (server->ctx)
      SSL_CTX_free(server->ctx);
@@ -848,7 +928,7 @@ server_run(server_t *server)
 
              if (sockets[i].revents != POLLIN)
                {
-                  server_client_t *client = _client_by_fd(server->clients, sockets[i].fd);
+                  server_client_t *client = _client_by_fd(server, sockets[i].fd);
                   if (client)
                     {
                        _on_del_cb(server, client);
@@ -868,7 +948,7 @@ server_run(server_t *server)
                }
              else
                {
-                  server_client_t *client = _client_by_fd(server->clients, sockets[i].fd);
+                  server_client_t *client = _client_by_fd(server, sockets[i].fd);
                   if (!client)
                     break;
 
@@ -922,6 +1002,14 @@ server_new(void)
    if (!server->clients)
      return NULL;
 
+   server->clients_by_fd = imap_new();
+   if (!server->clients_by_fd)
+     return NULL;
+
+   server->clients_pool = pool_new(sizeof(server_client_t));
+   if (!server->clients_pool)
+     return NULL;
+
    server_config_port_set(server, 12345);
    server_config_clients_max_set(server, 128);
    server->enabled = true;
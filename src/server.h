@@ -11,6 +11,9 @@
 #include <unistd.h>
 #include <openssl/ssl.h>
 #include <openssl/err.h>
+#include "bufchain.h"
+#include "imap.h"
+#include "pool.h"
 
 /**
  * @brief Creation, management and manipulation of a server.
@@ -124,6 +127,8 @@ struct server_t
    struct pollfd *sockets;
    int            poll_array_size;
    server_client_t      **clients;
+   imap_t               *clients_by_fd;
+   pool_t               *clients_pool;
    /* Callbacks */
 
    callback_fn  client_add_cb;
@@ -248,6 +253,23 @@ server_event_callback_set(server_t *server, server_callback_t type, int (*func)(
 int
 server_client_write(server_client_t *client, const char *buf, size_t len);
 
+/**
+ * Write a chain of segments to a client connected to the server.
+ *
+ * Plain connections send the segments with sendmsg() without copying
+ * them. Whatever the socket doesn't accept stays in the chain, so the call
+ * can be repeated with the same chain to carry on. Websocket clients get
+ * the whole chain as a single message, which is only consumed once the
+ * whole frame has been sent.
+ *
+ * @param client The client to send data to.
+ * @param chain The data to send, written bytes are consumed from it.
+ *
+ * @return On error will return -1 otherwise the number of bytes written.
+ */
+int
+server_client_write_chain(server_client_t *client, bufchain_t *chain);
+
 /**
  * Delete a client from a server.
  *
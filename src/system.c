@@ -117,17 +117,25 @@ system_disk_mount_point_get(const char *path)
 }
 
 static int
-_cmp_cb(void *p1, void *p2)
+_cmp_cb(const void *p1, const void *p2)
 {
    const char *s1, *s2;
 
-   s1 = p1; s2 = p2;
+   s1 = *(char * const *) p1; s2 = *(char * const *) p2;
 
    return strcmp(s1, s2);
 }
 
-list_t *
-system_disks_get(void)
+/* Append a device path to disks, taking ownership of it. */
+static void
+_disks_add(array_t *disks, char *path)
+{
+   if (path && !array_append(disks, &path))
+     free(path);
+}
+
+array_t *
+system_disks_array_get(void)
 {
 #if defined(__FreeBSD__) || defined(__DragonFly__)
    struct statfs *mounts;
@@ -147,7 +155,13 @@ system_disks_get(void)
         return NULL;
      }
 
-   list_t *list = list_new();
+   array_t *disks = array_new(sizeof(char *));
+   if (!disks)
+     {
+        free(drives);
+        return NULL;
+     }
+
    dev = drives;
    while (dev)
      {
@@ -159,7 +173,7 @@ system_disks_get(void)
 
         snprintf(buf, sizeof(buf), "/dev/%s", dev);
 
-        list = list_add(list, strdup(buf));
+        _disks_add(disks, strdup(buf));
 
         dev = end + 1;
      }
@@ -169,12 +183,12 @@ system_disks_get(void)
    count = getmntinfo(&mounts, MNT_WAIT);
    for (i = 0; i < count; i++)
      {
-        list = list_add(list, strdup(mounts[i].f_mntfromname));
+        _disks_add(disks, strdup(mounts[i].f_mntfromname));
      }
 
-   list = list_sort(list, _cmp_cb);
+   array_sort(disks, _cmp_cb);
 
-   return list;
+   return disks;
 #elif defined(__OpenBSD__) || defined(__NetBSD__)
    static const int mib[] = { CTL_HW, HW_DISKNAMES };
    static const unsigned int miblen = 2;
@@ -195,7 +209,12 @@ system_disks_get(void)
 	return NULL;
      }
 
-   list_t *list = list_new();
+   array_t *disks = array_new(sizeof(char *));
+   if (!disks)
+     {
+        free(drives);
+        return NULL;
+     }
 
    dev = drives;
    while (dev)
@@ -210,7 +229,7 @@ system_disks_get(void)
 
 	snprintf(buf, sizeof(buf), "/dev/%s", dev);
 
-        list = list_add(list, strdup(buf));
+        _disks_add(disks, strdup(buf));
 
         end++;
 	dev = strchr(end, ',');
@@ -222,18 +241,20 @@ system_disks_get(void)
    count = getmntinfo(&mounts, MNT_WAIT);
    for (i = 0; i < count; i++)
      {
-        list = list_add(list, strdup(mounts[i].f_mntfromname));
+        _disks_add(disks, strdup(mounts[i].f_mntfromname));
      }
 
-   list = list_sort(list, _cmp_cb);
+   array_sort(disks, _cmp_cb);
 
-   return list;
+   return disks;
 #elif defined(__MacOS__)
    char *name;
    char buf[4096];
-   list_t *devs, *l, *list;
+   list_t *devs, *l;
+   array_t *disks;
 
-   list  = list_new();
+   disks = array_new(sizeof(char *));
+   if (!disks) return NULL;
 
    devs = file_ls("/dev");
 
@@ -244,22 +265,24 @@ system_disks_get(void)
         if (!strncmp(name, "disk", 4))
           {
              snprintf(buf, sizeof(buf), "/dev/%s", name);
-             list = list_add(list, strdup(buf));
+             _disks_add(disks, strdup(buf));
           }
         l = l->next;
      }
 
    list_free(devs);
 
-   list = list_sort(list, _cmp_cb);
+   array_sort(disks, _cmp_cb);
 
-   return list;
+   return disks;
 #elif defined(__linux__)
    char *name;
-   list_t *l, *devs, *list;
+   list_t *l, *devs;
+   array_t *disks;
    char buf[4096];
 
-   list = list_new();
+   disks = array_new(sizeof(char *));
+   if (!disks) return NULL;
 
    devs = file_ls("/dev/disk/by-path");
 
@@ -271,7 +294,7 @@ system_disks_get(void)
         char *real = realpath(buf, NULL);
         if (real)
           {
-             list = list_add(list, real);
+             _disks_add(disks, real);
           }
         l = l->next;
      }
@@ -284,18 +307,41 @@ system_disks_get(void)
      {
         name = l->data;
         snprintf(buf, sizeof(buf), "/dev/mapper/%s", name);
-        list = list_add(list, strdup(buf));
+        _disks_add(disks, strdup(buf));
         l = l->next;
      }
 
    list_free(devs);
 
+   array_sort(disks, _cmp_cb);
 
-   list = list_sort(list, _cmp_cb);
-
-   return list;
+   return disks;
 #else
 
    return NULL;
 #endif
 }
+
+list_t *
+system_disks_get(void)
+{
+   array_t *disks;
+   list_head_t list;
+   char **path;
+   size_t i;
+
+   disks = system_disks_array_get();
+   if (!disks) return NULL;
+
+   list_head_init(&list);
+
+   ARRAY_FOREACH(disks, i, path)
+     {
+        if (!list_head_append(&list, *path))
+          free(*path);
+     }
+
+   array_free(disks);
+
+   return list_head_steal(&list);
+}
@@ -1,6 +1,7 @@
 #ifndef __SYSTEM_H__
 #define __SYSTEM_H__
 #include <sys/types.h>
+#include "array.h"
 #include "list.h"
 
 /**
@@ -39,6 +40,14 @@ system_cpu_count(void);
 list_t *
 system_disks_get(void);
 
+/**
+ * Return the available disks/drives on the system in a sorted array.
+ *
+ * @return An array of (char *) device paths, each to be freed along with the array, or NULL on failure.
+ */
+array_t *
+system_disks_array_get(void);
+
 /**
  * Return the mount point of a device path if mounted.
  *
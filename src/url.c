@@ -1,6 +1,7 @@
 #include "errors.h"
 #include "url.h"
 #include "net.h"
+#include "bufchain.h"
 #include <ctype.h>
 
 static char *
@@ -112,15 +113,35 @@ _connect_tcp(const char *hostname, int port)
    return sock;
 }
 
-static ssize_t
-Write(url_t *url, char *bytes, size_t len)
+/* Write a whole chain, scatter/gather straight to the socket when not using TLS. */
+static bool
+_write_chain(url_t *url, bufchain_t *chain)
 {
-   if (url->connection_ssl)
+   const char *data;
+   ssize_t bytes;
+
+   while (bufchain_len(chain))
      {
-        return BIO_write(url->tls->bio, bytes, len);
+        if (url->connection_ssl)
+          {
+             bytes = bufchain_peek(chain, &data);
+             if (bytes > 0)
+               {
+                  bytes = BIO_write(url->tls->bio, data, bytes);
+                  if (bytes > 0)
+                    bufchain_consume(chain, bytes);
+               }
+          }
+        else
+          {
+             bytes = bufchain_writev(chain, url->sock);
+          }
+
+        if (bytes <= 0)
+          return false;
      }
 
-   return write(url->sock, bytes, len);
+   return true;
 }
 
 static ssize_t
@@ -334,14 +355,24 @@ _http_connect(url_t *url)
 
    if (url->tls || url->sock)
      {
-        char query[4096];
-
-        snprintf(query, sizeof(query), "GET /%s HTTP/1.1\r\n"
-                                       "User-Agent: %s\r\n"
-                                       "Accept: */*\r\n"
-                                       "Host: %s\r\n\r\n", url->path, url->user_agent, url->host);
-
-        Write(url, query, strlen(query));
+        bufchain_t *query = bufchain_new();
+        if (!query)
+          errors_fail("bufchain_new");
+
+        /* The url outlives the request, so its fields are sent in place. */
+        if (!bufchain_append_string(query, "GET /") ||
+            !bufchain_append_static(query, url->path, strlen(url->path)) ||
+            !bufchain_append_string(query, " HTTP/1.1\r\nUser-Agent: ") ||
+            !bufchain_append_static(query, url->user_agent, strlen(url->user_agent)) ||
+            !bufchain_append_string(query, "\r\nAccept: */*\r\nHost: ") ||
+            !bufchain_append_static(query, url->host, strlen(url->host)) ||
+            !bufchain_append_string(query, "\r\n\r\n"))
+          errors_fail("bufchain_append");
+
+        if (!_write_chain(url, query))
+          errors_fail("unable to send request");
+
+        bufchain_free(query);
      }
 }
 
@@ -350,6 +381,7 @@ _http_headers_get(url_t *url)
 {
    char *buf, *key, *value;
    char *p, *start, *end;
+   size_t key_len;
    int len = 0, bytes = 0, buf_size;
    bool ret = false;
 
@@ -399,9 +431,9 @@ _http_headers_get(url_t *url)
         end = strchr(start, ':');
 
         if (!end) break;
-        *end = '\0';
 
         key = start;
+        key_len = end - start;
         start = end + 1;
         value = start;
 
@@ -414,7 +446,7 @@ _http_headers_get(url_t *url)
         if (!end) break;
         *end = '\0';
 
-        hash_add(url->headers, key, strdup(value));
+        hash_add_n(url->headers, key, key_len, strdup(value));
         p = end + 1;
      }
 done:
@@ -13,6 +13,7 @@ static hash_t *
 _headers_get(char *buf)
 {
    char *key, *start, *end, *p;
+   size_t key_len;
    hash_t *headers;
    char uri[1024];
 
@@ -36,9 +37,8 @@ _headers_get(char *buf)
         if (!end)
           break;
 
-        *end = '\0';
-
         key = &start[0];
+        key_len = end - start;
         start = end + 1;
         if (!start)
           break;
@@ -52,7 +52,7 @@ _headers_get(char *buf)
 
         *end = '\0';
 
-        hash_add(headers, key, strdup(start));
+        hash_add_n(headers, key, key_len, strdup(start));
 
         p = end + 1;
      }
@@ -240,6 +240,8 @@ ws_client_write(server_client_t *client, const char *mesg, size_t length)
      }
 
    char *response = malloc(index + length);
+   if (!response)
+     return 0;
 
    for (i = 0; i < index; i++)
      {
@@ -251,13 +253,19 @@ ws_client_write(server_client_t *client, const char *mesg, size_t length)
         response[index_response++] = mesg[i];
      }
 
+   ssize_t sent;
+
    if (client->ssl)
-     SSL_write(client->ssl, response, index + length);
+     sent = SSL_write(client->ssl, response, index + length);
    else
-     send(client->sock, response, index + length, MSG_NOSIGNAL);
+     sent = send(client->sock, response, index + length, MSG_NOSIGNAL);
 
    free(response);
 
+   /* Report nothing written unless the whole frame went out. */
+   if (sent != (ssize_t) (index + length))
+     return 0;
+
    return length;
 }
 
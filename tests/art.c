@@ -0,0 +1,89 @@
+/* Benchmark: memory per key and lookup latency, art_t versus tree_t, on
+ * clustered keys. Key counts may be given as arguments, 100M needs about
+ * 8GB of memory. */
+
+#include "art.h"
+#include "btree.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define CLUSTER  4096
+#define LOOKUPS  4000000
+
+static double
+_now(void)
+{
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+
+   return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void
+_run(size_t count)
+{
+   size_t *keys = malloc(count * sizeof(size_t));
+   unsigned int seed = 1;
+   tree_t *tree = tree_new();
+   art_t *art = art_new();
+   double start, add, find;
+
+   /* Runs of consecutive ids starting at random points. */
+   for (size_t i = 0; i < count; i += CLUSTER)
+     {
+        size_t base = ((size_t) rand_r(&seed) << 32) ^ ((size_t) rand_r(&seed) << 12);
+
+        for (size_t j = 0; j < CLUSTER && i + j < count; j++)
+          keys[i + j] = base + j;
+     }
+
+   start = _now();
+   for (size_t i = 0; i < count; i++)
+     art_add(art, keys[i], NULL);
+   add = _now() - start;
+
+   start = _now();
+   for (size_t i = 0; i < LOOKUPS; i++)
+     art_find(art, keys[rand_r(&seed) % count]);
+   find = _now() - start;
+
+   printf("%10zu  art_t   %5.1f bytes/key  add %6.3fs  find %6.1f ns/op\n",
+          count, (double) art->memory / art->count, add, find * 1e9 / LOOKUPS);
+
+   art_free(art);
+
+   start = _now();
+   for (size_t i = 0; i < count; i++)
+     tree = tree_add(tree, keys[i], NULL);
+   add = _now() - start;
+
+   start = _now();
+   for (size_t i = 0; i < LOOKUPS; i++)
+     tree_find(tree, keys[rand_r(&seed) % count]);
+   find = _now() - start;
+
+   printf("%10zu  tree_t  %5.1f bytes/key  add %6.3fs  find %6.1f ns/op\n",
+          count, (double) sizeof(tree_t), add, find * 1e9 / LOOKUPS);
+
+   tree_free(tree);
+   free(keys);
+}
+
+int
+main(int argc, char **argv)
+{
+   if (argc > 1)
+     {
+        for (int i = 1; i < argc; i++)
+          _run(strtoul(argv[i], NULL, 10));
+     }
+   else
+     {
+        _run(1000000);
+        _run(10000000);
+     }
+
+   return EXIT_SUCCESS;
+}
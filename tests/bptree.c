@@ -0,0 +1,80 @@
+/* Benchmark: point lookups and ordered scans, tree_t versus bptree_t. */
+
+#include "btree.h"
+#include "bptree.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define KEYS_MAX 1000000
+#define LOOKUPS  4000000
+
+static double
+_now(void)
+{
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+
+   return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int
+_scan_cb(size_t key, void *value, void *data)
+{
+   size_t *sum = data;
+
+   *sum += key;
+
+   return 0;
+}
+
+int
+main(void)
+{
+   tree_t *tree = tree_new();
+   bptree_t *bptree = bptree_new();
+   size_t *keys = malloc(KEYS_MAX * sizeof(size_t));
+   unsigned int seed = 1;
+   size_t sum = 0, visited;
+   double start, elapsed;
+
+   if (!keys || !bptree)
+     return EXIT_FAILURE;
+
+   for (size_t i = 0; i < KEYS_MAX; i++)
+     keys[i] = ((size_t) rand_r(&seed) << 31) ^ rand_r(&seed);
+
+   start = _now();
+   for (size_t i = 0; i < KEYS_MAX; i++)
+     tree = tree_add(tree, keys[i], NULL);
+   printf("tree_t   add %.3fs", _now() - start);
+
+   start = _now();
+   for (size_t i = 0; i < LOOKUPS; i++)
+     tree_find(tree, keys[rand_r(&seed) % KEYS_MAX]);
+   elapsed = _now() - start;
+   printf("  find %.1f ns/op\n", elapsed * 1e9 / LOOKUPS);
+
+   start = _now();
+   for (size_t i = 0; i < KEYS_MAX; i++)
+     bptree_add(bptree, keys[i], NULL);
+   printf("bptree_t add %.3fs", _now() - start);
+
+   start = _now();
+   for (size_t i = 0; i < LOOKUPS; i++)
+     bptree_find(bptree, keys[rand_r(&seed) % KEYS_MAX]);
+   elapsed = _now() - start;
+   printf("  find %.1f ns/op  height %u\n", elapsed * 1e9 / LOOKUPS, bptree->height);
+
+   start = _now();
+   visited = bptree_scan(bptree, 0, SIZE_MAX, _scan_cb, &sum);
+   elapsed = _now() - start;
+   printf("bptree_t full scan of %zu keys %.1f ns/key\n", visited, elapsed * 1e9 / visited);
+
+   tree_free(tree);
+   bptree_free(bptree);
+   free(keys);
+
+   return EXIT_SUCCESS;
+}
@@ -0,0 +1,173 @@
+/* Benchmark: building buffers from small appends against reallocating on
+ * every append, as buf_append_data() did before buffers tracked capacity,
+ * building short paths in heap and stack buffers, and reading a file
+ * through stdio in 1 KB blocks against buf_read_all(). */
+
+#include "buf.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#define BUFFERS 20000
+#define APPENDS 500
+#define FILE_SIZE (4 * 1024 * 1024)
+#define FILE_READS 100
+
+static double
+_now(void)
+{
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+
+   return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+typedef struct _exact_t
+{
+   ssize_t len;
+   char   *data;
+} exact_t;
+
+static void
+_append_realloc(exact_t *buf, const char *data, ssize_t len)
+{
+   buf->data = realloc(buf->data, buf->len + len + 1);
+   memcpy(buf->data + buf->len, data, len);
+   buf->len += len;
+}
+
+/* Build every buffer from APPENDS pieces, in one of three ways. */
+static double
+_run(int mode, const char *piece, ssize_t len)
+{
+   double start = _now();
+
+   for (int i = 0; i < BUFFERS; i++)
+     {
+        if (mode == 0)
+          {
+             exact_t exact = { 0, NULL };
+
+             for (int j = 0; j < APPENDS; j++)
+               _append_realloc(&exact, piece, len);
+
+             free(exact.data);
+             continue;
+          }
+
+        buf_t *buf = buf_new();
+
+        if (mode == 2)
+          buf_reserve(buf, len * APPENDS);
+
+        for (int j = 0; j < APPENDS; j++)
+          buf_append_data(buf, piece, len);
+
+        buf_free(buf);
+     }
+
+   return (double) BUFFERS * APPENDS * len / (_now() - start) / 1e6;
+}
+
+/* Build short paths as file_path_walk() does, on the heap or on the stack. */
+static double
+_run_paths(bool stack)
+{
+   double start = _now();
+   buf_t local, *path;
+
+   for (int i = 0; i < BUFFERS * 50; i++)
+     {
+        if (stack)
+          {
+             path = &local;
+             buf_init(path);
+          }
+        else
+          {
+             path = buf_new();
+          }
+
+        buf_append_printf(path, "%s/%s", "/usr/share/doc", "README.md");
+        if (!buf_string_get(path)[0])
+          abort();
+
+        if (stack)
+          buf_clear(path);
+        else
+          buf_free(path);
+     }
+
+   return BUFFERS * 50 / (_now() - start) / 1e6;
+}
+
+/* Read a file as file_contents_get() did, through fread(), or straight into the buffer. */
+static double
+_run_file(const char *path, bool direct)
+{
+   double start = _now();
+
+   for (int i = 0; i < FILE_READS; i++)
+     {
+        buf_t *buf = buf_new();
+
+        if (direct)
+          {
+             int fd = open(path, O_RDONLY);
+             buf_read_all(buf, fd);
+             close(fd);
+          }
+        else
+          {
+             FILE *f = fopen(path, "r");
+             buf_reserve(buf, FILE_SIZE);
+             while (!feof(f) && !ferror(f))
+               {
+                  buf_grow(buf, 1024);
+                  buf->len += fread(buf->data + buf->len, 1, buf->size - buf->len - 1, f);
+               }
+             fclose(f);
+          }
+
+        if (buf->len != FILE_SIZE)
+          abort();
+
+        buf_free(buf);
+     }
+
+   return (double) FILE_READS * FILE_SIZE / (_now() - start) / 1e6;
+}
+
+int
+main(void)
+{
+   static const char *piece = "key: value\r\n";
+   ssize_t len = strlen(piece);
+
+   printf("%d buffers of %d appends of %zd bytes\n", BUFFERS, APPENDS, len);
+   printf("realloc per append: %8.2f MB/s\n", _run(0, piece, len));
+   printf("doubling capacity:  %8.2f MB/s\n", _run(1, piece, len));
+   printf("buf_reserve first:  %8.2f MB/s\n", _run(2, piece, len));
+
+   printf("short paths, buf_new():  %6.2f M/s\n", _run_paths(false));
+   printf("short paths, buf_init(): %6.2f M/s\n", _run_paths(true));
+
+   char path[] = "/tmp/buf_bench_XXXXXX";
+   char *block = calloc(1, FILE_SIZE);
+   int fd = mkstemp(path);
+   if (fd == -1 || write(fd, block, FILE_SIZE) != FILE_SIZE)
+     abort();
+   close(fd);
+   free(block);
+
+   printf("file, fread() blocks:    %8.2f MB/s\n", _run_file(path, false));
+   printf("file, buf_read_all():    %8.2f MB/s\n", _run_file(path, true));
+
+   unlink(path);
+
+   return EXIT_SUCCESS;
+}
@@ -0,0 +1,139 @@
+/* Benchmark: a hash_t behind one lock versus a striped chash_t. */
+
+#include "chash.h"
+#include "hash.h"
+#include "system.h"
+#include "thread.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define KEYS_MAX 100000
+#define OPS_PER_THREAD 1000000
+
+static char *keys[KEYS_MAX];
+
+static hash_t *hashtable;
+static lock_t hashtable_lock;
+static chash_t *chash;
+
+typedef struct worker_t
+{
+   unsigned int seed;
+   bool striped;
+} worker_t;
+
+static double
+_now(void)
+{
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+
+   return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* 90% lookups, 10% replacing adds. */
+static void *
+_worker(thread_t *thread, void *data)
+{
+   worker_t *worker = data;
+
+   for (int i = 0; i < OPS_PER_THREAD; i++)
+     {
+        const char *key = keys[rand_r(&worker->seed) % KEYS_MAX];
+        bool add = (i % 10) == 0;
+
+        if (worker->striped)
+          {
+             if (add)
+               chash_add(chash, key, NULL);
+             else
+               chash_find(chash, key);
+          }
+        else
+          {
+             lock_take(&hashtable_lock);
+             if (add)
+               hash_add(hashtable, key, NULL);
+             else
+               hash_find(hashtable, key);
+             lock_release(&hashtable_lock);
+          }
+     }
+
+   return NULL;
+}
+
+static double
+_run(int count, bool striped)
+{
+   thread_t *threads[count];
+   worker_t workers[count];
+   double start;
+
+   start = _now();
+
+   for (int i = 0; i < count; i++)
+     {
+        workers[i].seed = i + 1;
+        workers[i].striped = striped;
+        threads[i] = thread_run(_worker, NULL, NULL, &workers[i]);
+     }
+
+   for (int i = 0; i < count; i++)
+     {
+        thread_wait(threads[i]);
+        free(threads[i]);
+     }
+
+   return (count * (double) OPS_PER_THREAD) / (_now() - start);
+}
+
+int
+main(void)
+{
+   char key[64];
+   int cpus = system_cpu_count();
+
+   for (int i = 0; i < KEYS_MAX; i++)
+     {
+        snprintf(key, sizeof(key), "session-%08x", i * 2654435761u);
+        keys[i] = strdup(key);
+     }
+
+   hashtable = hash_new();
+   lock_init(&hashtable_lock);
+   chash = chash_new(0);
+
+   for (int i = 0; i < KEYS_MAX; i++)
+     {
+        hash_add(hashtable, keys[i], NULL);
+        chash_add(chash, keys[i], NULL);
+     }
+
+   printf("threads  locked hash_t (Mops/s)  chash_t (Mops/s)\n");
+
+   for (int n = 1; ; n = (n << 1) > cpus ? cpus : n << 1)
+     {
+        double locked = _run(n, false);
+        double striped = _run(n, true);
+
+        printf("%7d  %22.2f  %16.2f\n", n, locked / 1e6, striped / 1e6);
+
+        if (n >= cpus)
+          break;
+     }
+
+   printf("chash count: %zu\n", chash_count(chash));
+
+   chash_free(chash);
+   hash_free(hashtable);
+   lock_destroy(&hashtable_lock);
+
+   for (int i = 0; i < KEYS_MAX; i++)
+     free(keys[i]);
+
+   return EXIT_SUCCESS;
+}
@@ -0,0 +1,122 @@
+/* Benchmark: lookups in a tree_t behind one lock versus a ctree_t. */
+
+#include "btree.h"
+#include "ctree.h"
+#include "system.h"
+#include "thread.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define KEYS_MAX 1000000
+#define OPS_PER_THREAD 2000000
+
+static size_t keys[KEYS_MAX];
+
+static tree_t *tree;
+static lock_t tree_lock;
+static ctree_t *ctree;
+
+typedef struct worker_t
+{
+   unsigned int seed;
+   bool optimistic;
+} worker_t;
+
+static double
+_now(void)
+{
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+
+   return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void *
+_worker(thread_t *thread, void *data)
+{
+   worker_t *worker = data;
+
+   for (int i = 0; i < OPS_PER_THREAD; i++)
+     {
+        size_t key = keys[rand_r(&worker->seed) % KEYS_MAX];
+
+        if (worker->optimistic)
+          {
+             ctree_find(ctree, key);
+          }
+        else
+          {
+             lock_take(&tree_lock);
+             tree_find(tree, key);
+             lock_release(&tree_lock);
+          }
+     }
+
+   return NULL;
+}
+
+static double
+_run(int count, bool optimistic)
+{
+   thread_t *threads[count];
+   worker_t workers[count];
+   double start;
+
+   start = _now();
+
+   for (int i = 0; i < count; i++)
+     {
+        workers[i].seed = i + 1;
+        workers[i].optimistic = optimistic;
+        threads[i] = thread_run(_worker, NULL, NULL, &workers[i]);
+     }
+
+   for (int i = 0; i < count; i++)
+     {
+        thread_wait(threads[i]);
+        free(threads[i]);
+     }
+
+   return (count * (double) OPS_PER_THREAD) / (_now() - start);
+}
+
+int
+main(void)
+{
+   unsigned int seed = 1;
+   int cpus = system_cpu_count();
+
+   tree = tree_new();
+   lock_init(&tree_lock);
+   ctree = ctree_new();
+
+   for (int i = 0; i < KEYS_MAX; i++)
+     {
+        keys[i] = ((size_t) rand_r(&seed) << 31) ^ rand_r(&seed);
+        tree = tree_add(tree, keys[i], NULL);
+        ctree_add(ctree, keys[i], NULL);
+     }
+
+   printf("threads  locked tree_t (Mops/s)  ctree_t (Mops/s)\n");
+
+   for (int n = 1; ; n = (n << 1) > cpus ? cpus : n << 1)
+     {
+        double locked = _run(n, false);
+        double optimistic = _run(n, true);
+
+        printf("%7d  %22.2f  %16.2f\n", n, locked / 1e6, optimistic / 1e6);
+
+        if (n >= cpus)
+          break;
+     }
+
+   printf("ctree count: %zu\n", ctree_count(ctree));
+
+   ctree_free(ctree);
+   tree_free(tree);
+   lock_destroy(&tree_lock);
+
+   return EXIT_SUCCESS;
+}
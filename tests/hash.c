@@ -0,0 +1,78 @@
+/* Benchmark: insert latency percentiles while a hash_t grows. */
+
+#include "hash.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#define KEYS_DEFAULT 10000000
+
+static uint64_t
+_now_ns(void)
+{
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+
+   return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static int
+_cmp_cb(const void *a, const void *b)
+{
+   uint32_t x = *(const uint32_t *) a, y = *(const uint32_t *) b;
+
+   return (x > y) - (x < y);
+}
+
+int
+main(int argc, char **argv)
+{
+   hash_t *hashtable;
+   uint32_t *latency;
+   uint64_t start, end, total;
+   size_t count = KEYS_DEFAULT;
+   char key[32];
+
+   if (argc > 1)
+     count = strtoul(argv[1], NULL, 10);
+
+   latency = malloc(count * sizeof(uint32_t));
+   if (!latency)
+     return EXIT_FAILURE;
+
+   hashtable = hash_new();
+
+   total = _now_ns();
+
+   for (size_t i = 0; i < count; i++)
+     {
+        snprintf(key, sizeof(key), "key-%zu", i);
+
+        start = _now_ns();
+        hash_add(hashtable, key, NULL);
+        end = _now_ns();
+
+        latency[i] = end - start > UINT32_MAX ? UINT32_MAX : end - start;
+     }
+
+   total = _now_ns() - total;
+
+   printf("%zu inserts in %.2fs, %zu slots\n", count, total / 1e9, hashtable->size);
+
+   qsort(latency, count, sizeof(uint32_t), _cmp_cb);
+
+   printf("insert latency (us): p50 %.3f  p99 %.3f  p99.9 %.3f  p99.99 %.3f  max %.3f\n",
+          latency[count / 2] / 1e3,
+          latency[(size_t) (count * 0.99)] / 1e3,
+          latency[(size_t) (count * 0.999)] / 1e3,
+          latency[(size_t) (count * 0.9999)] / 1e3,
+          latency[count - 1] / 1e3);
+
+   hash_free(hashtable);
+   free(latency);
+
+   return EXIT_SUCCESS;
+}
@@ -0,0 +1,92 @@
+/* Benchmark: list_sort() and list_sort_parallel() on lists of strings. */
+
+#include "list.h"
+#include "system.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static double
+_now(void)
+{
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+
+   return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int
+_cmp_cb(void *first, void *second)
+{
+   return strcmp(first, second);
+}
+
+static list_t *
+_list_build(size_t count, unsigned int seed)
+{
+   list_head_t head;
+   char word[32];
+
+   list_head_init(&head);
+
+   for (size_t i = 0; i < count; i++)
+     {
+        snprintf(word, sizeof(word), "%08x%08x", rand_r(&seed), rand_r(&seed));
+        list_head_append(&head, strdup(word));
+     }
+
+   return list_head_steal(&head);
+}
+
+static bool
+_list_sorted(list_t *list)
+{
+   list_t *l;
+
+   for (l = list; l && l->next; l = l->next)
+     {
+        if (_cmp_cb(l->data, l->next->data) > 0)
+          return false;
+     }
+
+   return true;
+}
+
+int
+main(void)
+{
+   static const size_t counts[] = { 10000, 100000, 1000000 };
+   int cpus = system_cpu_count();
+
+   printf("%8s  %16s  %24s\n", "count", "list_sort (ms)", "list_sort_parallel (ms)");
+
+   for (int i = 0; i < sizeof(counts) / sizeof(counts[0]); i++)
+     {
+        list_t *list;
+        double start, serial, parallel;
+        bool ok;
+
+        list = _list_build(counts[i], i + 1);
+        start = _now();
+        list = list_sort(list, _cmp_cb);
+        serial = _now() - start;
+        ok = _list_sorted(list);
+        list_free(list);
+
+        list = _list_build(counts[i], i + 1);
+        start = _now();
+        list = list_sort_parallel(list, _cmp_cb, cpus);
+        parallel = _now() - start;
+        ok = ok && _list_sorted(list);
+        list_free(list);
+
+        printf("%8zu  %16.2f  %24.2f%s\n", counts[i], serial * 1000, parallel * 1000,
+               ok ? "" : "  NOT SORTED");
+     }
+
+   printf("threads: %d\n", cpus);
+
+   return EXIT_SUCCESS;
+}
@@ -0,0 +1,265 @@
+/* Benchmark: passing a byte stream from one thread to another through a
+ * buf_t behind a lock versus a ring_t, with and without its mirror mapping,
+ * and checking the bytes arrive intact and in order. */
+
+#include "buf.h"
+#include "ring.h"
+#include "thread.h"
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define RING_SIZE (64 * 1024)
+#define TOTAL (256 * 1024 * 1024L)
+#define CHUNK 1500
+
+static buf_t *buf;
+static lock_t buf_lock;
+
+static double
+_now(void)
+{
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+
+   return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Stream bytes i % 251, so a lost, repeated or reordered byte shows up. */
+static void
+_fill(char *data, size_t len, size_t pos)
+{
+   for (size_t i = 0; i < len; i++)
+     data[i] = (pos + i) % 251;
+}
+
+static bool
+_check(const char *data, size_t len, size_t pos)
+{
+   for (size_t i = 0; i < len; i++)
+     if (data[i] != (char) ((pos + i) % 251))
+       return false;
+
+   return true;
+}
+
+static void *
+_producer_locked(thread_t *thread, void *data)
+{
+   char chunk[CHUNK];
+   size_t pos = 0;
+
+   (void) thread; (void) data;
+
+   while (pos < TOTAL)
+     {
+        size_t len = TOTAL - pos < CHUNK ? TOTAL - pos : CHUNK;
+
+        _fill(chunk, len, pos);
+
+        for (;;)
+          {
+             lock_take(&buf_lock);
+             if (buf->len + len <= RING_SIZE)
+               break;
+             lock_release(&buf_lock);
+             sched_yield();
+          }
+
+        buf_append_data(buf, chunk, len);
+        lock_release(&buf_lock);
+        pos += len;
+     }
+
+   return NULL;
+}
+
+static void *
+_producer_ring(thread_t *thread, void *data)
+{
+   ring_t *ring = data;
+   char chunk[CHUNK];
+   size_t pos = 0, len, done;
+
+   (void) thread;
+
+   while (pos < TOTAL)
+     {
+        len = TOTAL - pos < CHUNK ? TOTAL - pos : CHUNK;
+
+        _fill(chunk, len, pos);
+
+        done = 0;
+        while (done < len)
+          {
+             size_t n = ring_push(ring, chunk + done, len - done);
+             if (!n)
+               sched_yield();
+             done += n;
+          }
+
+        pos += len;
+     }
+
+   return NULL;
+}
+
+static double
+_run_locked(void)
+{
+   char *out = malloc(RING_SIZE);
+   thread_t *thread;
+   size_t pos = 0;
+   double start;
+   bool ok = true;
+
+   buf = buf_new();
+   lock_init(&buf_lock);
+
+   start = _now();
+
+   thread = thread_run(_producer_locked, NULL, NULL, NULL);
+
+   while (pos < TOTAL)
+     {
+        size_t len;
+
+        lock_take(&buf_lock);
+        len = buf->len;
+        memcpy(out, buf->data, len);
+        buf_reset(buf);
+        lock_release(&buf_lock);
+
+        if (!len)
+          {
+             sched_yield();
+             continue;
+          }
+
+        ok &= _check(out, len, pos);
+        pos += len;
+     }
+
+   thread_wait(thread);
+   free(thread);
+
+   if (!ok)
+     printf("locked buf_t: data mismatch!\n");
+
+   buf_free(buf);
+   lock_destroy(&buf_lock);
+   free(out);
+
+   return TOTAL / (_now() - start) / 1e6;
+}
+
+/* Consume in place through ring_read_ptr(), without copying out. */
+static double
+_run_ring(unsigned int flags)
+{
+   ring_t *ring = ring_new(RING_SIZE, flags);
+   thread_t *thread;
+   const void *ptr;
+   size_t pos = 0;
+   double start;
+   bool ok = true;
+
+   if (!ring)
+     return 0;
+
+   if ((flags & RING_MIRROR) && !ring->mirrored)
+     printf("ring_t: no mirror mapping here, using split runs\n");
+
+   start = _now();
+
+   thread = thread_run(_producer_ring, NULL, NULL, ring);
+
+   while (pos < TOTAL)
+     {
+        size_t len = ring_read_ptr(ring, &ptr);
+        if (!len)
+          {
+             sched_yield();
+             continue;
+          }
+
+        ok &= _check(ptr, len, pos);
+        ring_read_commit(ring, len);
+        pos += len;
+     }
+
+   thread_wait(thread);
+   free(thread);
+
+   if (!ok)
+     printf("ring_t: data mismatch!\n");
+
+   ring_free(ring);
+
+   return TOTAL / (_now() - start) / 1e6;
+}
+
+/* Pass a stream through a pipe into a ring and back out through another. */
+static bool
+_run_fd(unsigned int flags)
+{
+   ring_t *ring = ring_new(4096, flags);
+   char data[10000], out[10000];
+   int in[2], outp[2];
+   size_t got = 0;
+   bool ok;
+
+   if (!ring || pipe(in) < 0 || pipe(outp) < 0)
+     return false;
+
+   _fill(data, sizeof(data), 0);
+
+   /* Offset the ring so the data wraps. */
+   ring_push(ring, data, 3000);
+   ring_pop(ring, out, 3000);
+
+   for (size_t sent = 0, taken = 0; got < sizeof(data); )
+     {
+        if (sent < sizeof(data))
+          {
+             size_t n = sizeof(data) - sent < 1000 ? sizeof(data) - sent : 1000;
+             sent += write(in[1], data + sent, n);
+          }
+
+        if (taken < sent)
+          {
+             ssize_t bytes = ring_read_fd(ring, in[0]);
+             if (bytes > 0)
+               taken += bytes;
+          }
+
+        ssize_t bytes = ring_write_fd(ring, outp[1]);
+        if (bytes > 0)
+          got += read(outp[0], out + got, bytes);
+     }
+
+   ok = got == sizeof(data) && !memcmp(data, out, got);
+
+   ring_free(ring);
+   close(in[0]); close(in[1]);
+   close(outp[0]); close(outp[1]);
+
+   return ok;
+}
+
+int
+main(void)
+{
+   printf("fd round trip: plain %s, mirrored %s\n",
+          _run_fd(0) ? "ok" : "FAILED", _run_fd(RING_MIRROR) ? "ok" : "FAILED");
+
+   printf("locked buf_t:     %8.1f MB/s\n", _run_locked());
+   printf("ring_t:           %8.1f MB/s\n", _run_ring(0));
+   printf("ring_t mirrored:  %8.1f MB/s\n", _run_ring(RING_MIRROR));
+
+   return EXIT_SUCCESS;
+}
@@ -1,11 +1,15 @@
 /* Just a test for the library code */
 
+#include "array.h"
 #include "btree.h"
 #include "buf.h"
+#include "bufchain.h"
 #include "list.h"
 #include "hash.h"
+#include "imap.h"
 #include "system.h"
 #include "file.h"
+#include "proc.h"
 #include "exe.h"
 #include "strings.h"
 #include <time.h>
@@ -13,6 +17,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdarg.h>
+#include <stdint.h>
 #include <unistd.h>
 #include <openssl/sha.h>
 
@@ -28,9 +33,20 @@ employee_t employees[] =  {
    { .id = 3, .name = "Jimmy" },
 };
 
+static int
+_tree_range_cb(size_t value, void *item, void *data)
+{
+   employee_t *emp = item;
+
+   printf("in range: %zu %s\n", value, emp->name);
+
+   return 0;
+}
+
 static void
 test_tree(void)
 {
+   tree_t *node;
    employee_t *found;
    tree_t *tree = tree_new();
 
@@ -45,6 +61,14 @@ test_tree(void)
    if (found)
      printf("it is %s\n", (char *) found->name);
 
+   tree_range_foreach(tree, 2, 3, _tree_range_cb, NULL);
+
+   for (node = tree_last(tree); node; node = tree_prev(node))
+     {
+        found = node->data;
+        printf("descending: %s\n", found->name);
+     }
+
    tree_free(tree);
 }
 
@@ -121,6 +145,164 @@ test_list(void)
    list = list_del(list, text);
 
    list_free(list);
+
+   list_head_t head;
+
+   list_head_init(&head);
+   list_head_append(&head, strdup("middle"));
+   list_head_append(&head, strdup("last"));
+   list_head_prepend(&head, strdup("first"));
+
+   LIST_HEAD_FOREACH(&head, l, item)
+     {
+        printf("list head member: %s\n", item);
+     }
+
+   printf("list head count: %zu last: %s\n", list_head_count(&head),
+          (char *) list_head_last(&head));
+
+   list_head_free(&head);
+
+   pool_t *pool = pool_new(sizeof(list_t));
+
+   list_head_init_pool(&head, pool);
+   for (i = 0; i < 1000; i++)
+     list_head_append(&head, _random_word_gen());
+
+   printf("pooled list count: %zu\n", list_head_count(&head));
+
+   list_head_free(&head);
+   pool_free(pool);
+}
+
+static int
+_int_cmp_cb(const void *first, const void *second)
+{
+   int a = *(const int *) first, b = *(const int *) second;
+
+   return (a > b) - (a < b);
+}
+
+static void
+test_array(void)
+{
+   array_t *array, *procs;
+   int values[] = { 42, 7, 19 };
+   int key, *value;
+   size_t i;
+
+   array = array_new(sizeof(int));
+
+   array_append_n(array, values, 3);
+   for (int n = 0; n < 5; n++)
+     array_append(array, &n);
+
+   array_sort(array, _int_cmp_cb);
+
+   ARRAY_FOREACH(array, i, value)
+     {
+        printf("array member: %d\n", *value);
+     }
+
+   key = 19;
+   value = array_bsearch(array, &key, _int_cmp_cb);
+   if (value)
+     printf("found %d in array of %zu\n", *value, array_count(array));
+
+   if (array_reserve(array, (size_t) -1 / 2 + 2))
+     printf("array reserve of an impossible size succeeded!\n");
+
+   array_free(array);
+
+   procs = proc_info_all_array_get();
+   if (procs)
+     {
+        printf("processes: %zu\n", array_count(procs));
+        array_free(procs);
+     }
+}
+
+IMAP_INLINE(imap_int, int)
+
+static int imap_failures;
+
+static void
+_imap_check(bool ok, const char *what)
+{
+   if (ok)
+     return;
+
+   printf("imap check failed: %s\n", what);
+   imap_failures++;
+}
+
+static bool
+_imap_has(imap_int_t *map, int64_t key, int value)
+{
+   int *found = imap_int_find(map, key);
+
+   return found && *found == value;
+}
+
+static void
+test_imap(void)
+{
+   int64_t chain[4], keys[] = { INT64_MIN, -1, INT64_MAX, (int64_t) 1 << 40, -((int64_t) 1 << 40) };
+   imap_int_t *map = imap_int_new();
+   size_t home, n = 0;
+
+   /* Add, find, replace and delete. */
+   _imap_check(imap_int_add(map, 3, 30), "add");
+   _imap_check(_imap_has(map, 3, 30), "find");
+   _imap_check(!imap_int_find(map, 4), "find missing");
+   _imap_check(imap_int_add(map, 3, 31) && map->count == 1, "replace keeps count");
+   _imap_check(_imap_has(map, 3, 31), "replace value");
+   _imap_check(imap_int_del(map, 3) && !imap_int_find(map, 3), "delete");
+   _imap_check(!imap_int_del(map, 3) && map->count == 0, "delete missing");
+
+   /* Keys sharing a home slot, deleting the head shifts the rest back. */
+   home = imap_int_index(map, 1);
+   for (int64_t key = 1; n < 3; key++)
+     if (imap_int_index(map, key) == home)
+       chain[n++] = key;
+   chain[3] = chain[2] + 1;
+   while (imap_int_index(map, chain[3]) != ((home + 1) & (map->size - 1)))
+     chain[3]++;
+
+   for (int i = 0; i < 4; i++)
+     imap_int_add(map, chain[i], i);
+
+   _imap_check(imap_int_del(map, chain[0]), "chain delete");
+   _imap_check(map->used[home] && map->slots[home].key == chain[1], "chain shifted back");
+   for (int i = 1; i < 4; i++)
+     _imap_check(_imap_has(map, chain[i], i), "chain find after shift");
+   _imap_check(!imap_int_find(map, chain[0]), "chain deleted key");
+
+   for (int i = 1; i < 4; i++)
+     imap_int_del(map, chain[i]);
+
+   /* Growth past the load factor and shrinking back. */
+   for (int i = 0; i < 1000; i++)
+     imap_int_add(map, i * 7, i);
+   _imap_check(map->count == 1000 && map->count * 4 <= map->size * 3, "growth");
+   for (int i = 0; i < 1000; i++)
+     _imap_check(_imap_has(map, i * 7, i), "find after growth");
+   for (int i = 0; i < 1000; i++)
+     imap_int_del(map, i * 7);
+   _imap_check(map->count == 0 && map->size == IMAP_SIZE_MIN, "shrink");
+
+   /* Negative and large keys. */
+   for (size_t i = 0; i < sizeof(keys) / sizeof(keys[0]); i++)
+     imap_int_add(map, keys[i], i);
+   for (size_t i = 0; i < sizeof(keys) / sizeof(keys[0]); i++)
+     _imap_check(_imap_has(map, keys[i], i), "find extreme key");
+   _imap_check(imap_int_del(map, INT64_MIN) && _imap_has(map, INT64_MAX, 2), "delete extreme key");
+
+   imap_int_free(map);
+
+   printf("imap: %s\n", imap_failures ? "FAILED" : "all checks passed");
+   if (imap_failures)
+     exit(EXIT_FAILURE);
 }
 
 static int
@@ -151,6 +333,45 @@ test_hash(void)
 
    hash_dump(hashtable);
 
+   hash_iter_t iter;
+   const char *key;
+   char *path;
+
+   HASH_FOREACH(hashtable, iter, key, path)
+     {
+        if (!strcmp(key, "mom!"))
+          hash_iter_del(&iter);
+     }
+
+   if (!hash_find(hashtable, "mom!"))
+     printf("deleted mom! while iterating\n");
+
+   hash_stats_t stats;
+   hash_stats(hashtable, &stats);
+   printf("hash: %zu keys in %zu slots (load %.2f), probe mean %.2f max %zu\n",
+          stats.count, stats.size, stats.load, stats.probe_mean, stats.probe_max);
+
+   if (hash_save(hashtable, "/tmp/testhash.db"))
+     {
+        hash_t *mapped = hash_mmap_open("/tmp/testhash.db");
+        if (mapped)
+          {
+             printf("mapped %zu keys, ./src/hash.c -> %s\n", mapped->count,
+                    (char *) hash_find(mapped, "./src/hash.c"));
+             hash_free(mapped);
+          }
+
+        /* Cutting off the last terminator must make the file unusable. */
+        if (truncate("/tmp/testhash.db", file_size_get("/tmp/testhash.db") - 1) == 0)
+          {
+             mapped = hash_mmap_open("/tmp/testhash.db");
+             printf("truncated hash file %s\n", mapped ? "accepted!" : "rejected");
+             if (mapped)
+               hash_free(mapped);
+          }
+        file_remove("/tmp/testhash.db");
+     }
+
    hash_free(hashtable);
 }
 
@@ -196,6 +417,44 @@ test_exe(void)
    file_remove(dirname);
 }
 
+static void
+test_bufchain(void)
+{
+   bufchain_t *chain;
+   char output[64];
+   int fds[2];
+   ssize_t bytes;
+
+   if (pipe(fds) < 0)
+     return;
+
+   chain = bufchain_new();
+   bufchain_append_static(chain, "HTTP/1.1 200 OK\r\n", 17);
+   bufchain_append_string(chain, "Content-Length: 5\r\n\r\n");
+   bufchain_append_ref(chain, strdup("hello"), 5, free);
+
+   bytes = bufchain_copy(chain, output, sizeof(output) - 1);
+   if (bytes > 0)
+     {
+        output[bytes] = 0x00;
+        printf("bufchain copied %zd bytes, %zu still pending\n", bytes, bufchain_len(chain));
+     }
+
+   bytes = bufchain_writev(chain, fds[1]);
+   printf("bufchain wrote %zd bytes, %zu left\n", bytes, bufchain_len(chain));
+
+   bytes = read(fds[0], output, sizeof(output) - 1);
+   if (bytes > 0)
+     {
+        output[bytes] = 0x00;
+        printf("bufchain output: %s\n", output);
+     }
+
+   bufchain_free(chain);
+   close(fds[0]);
+   close(fds[1]);
+}
+
 static void
 test_system(void)
 {
@@ -383,8 +642,14 @@ main(void)
 
    test_list();
 
+   test_array();
+
+   test_imap();
+
    test_tree();
 
+   test_bufchain();
+
    test_system();
 
    test_file("/etc/passwd");
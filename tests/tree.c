@@ -0,0 +1,113 @@
+/* Benchmark: tree_t insertion and lookup with sequential versus random keys,
+ * and lookups in a bulk loaded tree before and after freezing it. */
+
+#include "btree.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define KEYS_MAX 1000000
+
+static double
+_now(void)
+{
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+
+   return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void
+_run(const char *name, size_t *keys, size_t count)
+{
+   tree_t *tree = tree_new();
+   double start, added, found;
+
+   start = _now();
+
+   for (size_t i = 0; i < count; i++)
+     tree = tree_add(tree, keys[i], NULL);
+
+   added = _now();
+
+   for (size_t i = 0; i < count; i++)
+     tree_find(tree, keys[i]);
+
+   found = _now();
+
+   printf("%-10s  %8zu keys  height %2d  add %.3fs  find %.3fs\n",
+          name, count, tree->height, added - start, found - added);
+
+   tree_free(tree);
+}
+
+static void
+_run_frozen(size_t *keys, size_t count)
+{
+   size_t *sorted = malloc(count * sizeof(size_t));
+   void **items = calloc(count, sizeof(void *));
+   tree_frozen_t *frozen;
+   tree_t *tree;
+   double start, built, found;
+
+   for (size_t i = 0; i < count; i++)
+     sorted[i] = i + 1;
+
+   start = _now();
+   tree = tree_build_sorted(sorted, items, count);
+   built = _now();
+
+   for (size_t i = 0; i < count; i++)
+     tree_find(tree, keys[i]);
+
+   found = _now();
+
+   printf("bulk load   %8zu keys  height %2d  build %.3fs  find %.3fs\n",
+          count, tree->height, built - start, found - built);
+
+   start = _now();
+   frozen = tree_freeze(tree);
+   built = _now();
+
+   for (size_t i = 0; i < count; i++)
+     tree_frozen_find(frozen, keys[i]);
+
+   found = _now();
+
+   printf("frozen      %8zu keys             freeze %.3fs  find %.3fs\n",
+          count, built - start, found - built);
+
+   tree_frozen_free(frozen);
+   free(sorted);
+   free(items);
+}
+
+int
+main(void)
+{
+   size_t *keys = malloc(KEYS_MAX * sizeof(size_t));
+   if (!keys)
+     return EXIT_FAILURE;
+
+   for (size_t i = 0; i < KEYS_MAX; i++)
+     keys[i] = i + 1;
+
+   _run("sequential", keys, KEYS_MAX);
+
+   srand(1);
+   for (size_t i = KEYS_MAX - 1; i > 0; i--)
+     {
+        size_t j = ((size_t) rand() * RAND_MAX + rand()) % (i + 1), tmp = keys[i];
+        keys[i] = keys[j];
+        keys[j] = tmp;
+     }
+
+   _run("random", keys, KEYS_MAX);
+
+   _run_frozen(keys, KEYS_MAX);
+
+   free(keys);
+
+   return EXIT_SUCCESS;
+}